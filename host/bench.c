@@ -0,0 +1,277 @@
+/*
+	bench.c		host harness
+	update pipeline benchmark: client workloads against emulated
+	VMware SVGA II, swept over pixel format, FIFO size and present
+	pacing
+
+		* DN_SCRUPDRECT goes through the driver port as a client
+		  request does (rwfn, setSCRUPDRECT)
+		* each configuration runs in its own process
+		* spin is regBUSY polled by the driver, counted by the
+		  device, no stats build is needed
+
+	Copyright 2026 by agent
+	This software is distributed under the T-License 2.0.
+*/
+#include "screen.h"
+#include "videomode.h"
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "host.h"
+
+#define	MAX_REQ		100000
+
+/* emulated host: QEMU-like cost of a command and of updated pixels */
+#define	CMD_COST	1000		/* nsec per command */
+#define	PIX_COST	500		/* nsec per 1024 pixels */
+
+LOCAL	struct {
+	UD	req[MAX_REQ];		/* service time of each request */
+	W	nreq;
+	UD	client;			/* bytes written by client */
+} Run;
+
+/* DN_SCRUPDRECT */
+LOCAL	void	updRect(W x, W y, W w, W h)
+{
+	UD	t;
+	RECT	r;
+
+	r.c.left = x;
+	r.c.top = y;
+	r.c.right = x + w;
+	r.c.bottom = y + h;
+
+	t = hostClock();
+	hostDevReq(DC_WRITE, DN_SCRUPDRECT, &r, sizeof(r), NULL);
+	if (Run.nreq < MAX_REQ) Run.req[Run.nreq++] = hostClock() - t;
+	return;
+}
+
+/* DN_SCRFLUSH: until the device has shown everything */
+LOCAL	void	flushWait(void)
+{
+	W	mode = FLUSH_WAIT;
+
+	hostDevReq(DC_WRITE, DN_SCRFLUSH, &mode, sizeof(mode), NULL);
+	return;
+}
+
+/* client draws a rectangle */
+LOCAL	void	draw(W x, W y, W w, W h, UB v)
+{
+	W	j;
+	UB	*p;
+
+	p = (UB *)Vinf.baseaddr + y * Vinf.rowbytes + x * Vinf.pixbyte;
+	for (j = 0; j < h; j++, p += Vinf.rowbytes) memset(p, v, w * Vinf.pixbyte);
+	Run.client += (UD)w * h * Vinf.pixbyte;
+	return;
+}
+
+/* ------------------------------------------------------------------------ */
+/*
+	workloads
+*/
+
+/* terminal output: 8x16 glyphs, one request each */
+LOCAL	void	wlTyping(void)
+{
+	W	i, x, y;
+
+	for (i = 0; i < 4000; i++) {
+		x = 16 + (i % 80) * 8;
+		y = 16 + ((i / 80) % 40) * 16;
+		draw(x, y, 8, 16, i);
+		updRect(x, y, 8, 16);
+		usleep(20);
+	}
+	return;
+}
+
+/* terminal scroll: 640x640 area moves up a line a msec, new line is drawn */
+LOCAL	void	wlScroll(void)
+{
+	W	i, y;
+	UB	*p;
+
+	for (i = 0; i < 300; i++) {
+		p = (UB *)Vinf.baseaddr + 16 * Vinf.rowbytes + 16 * Vinf.pixbyte;
+		for (y = 0; y < 640 - 16; y++, p += Vinf.rowbytes)
+			memmove(p, p + 16 * Vinf.rowbytes, 640 * Vinf.pixbyte);
+		Run.client += (UD)640 * (640 - 16) * Vinf.pixbyte;
+		draw(16, 16 + 640 - 16, 640, 16, i);
+		updRect(16, 16, 640, 640);
+		usleep(1000);
+	}
+	return;
+}
+
+/* window drag: 400x300 window moves with a 1kHz mouse */
+LOCAL	void	wlDrag(void)
+{
+	W	i, x, y, ox, oy;
+
+	ox = oy = 0;
+	for (i = 0; i < 500; i++) {
+		x = (i * 3) % (1024 - 400);
+		y = (i * 2) % (768 - 300);
+
+		/* exposed background, then the window */
+		draw(ox, oy, 400, 300, 0);
+		updRect(ox, oy, 400, 300);
+		draw(x, y, 400, 300, i);
+		updRect(x, y, 400, 300);
+		ox = x;
+		oy = y;
+		usleep(1000);
+	}
+	return;
+}
+
+/* full screen video, 60 frames at 120 fps */
+LOCAL	void	wlVideo(void)
+{
+	W	i;
+
+	for (i = 0; i < 60; i++) {
+		draw(0, 0, Vinf.width, Vinf.height, i);
+		updRect(0, 0, Vinf.width, Vinf.height);
+		usleep(8333);
+	}
+	return;
+}
+
+LOCAL	CONST	struct {
+	CONST B	*name;
+	void	(*fn)(void);
+} Workload[] = {
+	{"typing", wlTyping},
+	{"scroll", wlScroll},
+	{"drag", wlDrag},
+	{"video", wlVideo},
+};
+
+#define	NUM_WORKLOAD	(sizeof(Workload) / sizeof(Workload[0]))
+
+/* ------------------------------------------------------------------------ */
+
+LOCAL	int	cmpTime(CONST void *a, CONST void *b)
+{
+	UD	x = *(UD *)a, y = *(UD *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* percentile (%) of request service time (usec) */
+LOCAL	double	percentile(W pct)
+{
+	if (Run.nreq == 0) return 0;
+	return Run.req[(Run.nreq - 1) * pct / 100] / 1000.0;
+}
+
+/*
+	run a workload in bpp format with VMSVGACMDENTRY entry (-1:
+	maximum, 0: FIFO and virtual VRAM off) and VIDEOVFREQ pace (0:
+	not paced)
+*/
+LOCAL	BOOL	runBench(W wl, W bpp, W entry, W pace)
+{
+	UD	t0, t1, t2;
+	double	sec;
+	SvgaCount	cnt0, cnt;
+	SvgaConf	conf = {
+		.cap = (1 << 0) | (1 << 1),	/* RECT_FILL, RECT_COPY */
+		.refresh = 16,
+		.cmdcost = CMD_COST,
+		.pixcost = PIX_COST,
+	};
+
+	hostSetConf("VIDEOMODE", 2, 4, bpp);	/* 1024x768 */
+	hostSetConf("VMSVGACMDENTRY", 1, entry);
+	if (pace > 0) hostSetConf("VIDEOVFREQ", 1, pace);
+	svgaStart(&conf);
+	if (hostInitScreen() < ER_OK) return FALSE;
+
+	/* start from idle device, initial clear is done */
+	flushWait();
+	svgaCount(&cnt0);
+
+	t0 = hostClock();
+	(*Workload[wl].fn)();
+	t1 = hostClock();
+
+	flushWait();
+	t2 = hostClock();
+
+	svgaCount(&cnt);
+	sec = (t2 - t0) / 1e9;
+	qsort(Run.req, Run.nreq, sizeof(UD), cmpTime);
+
+	printf("%-7s %3d %5d %4d %8.0f %7.0f %7.0f %9u ",
+	       Workload[wl].name, (Vinf.pixbits >> 8) & 0xff, entry, pace,
+	       Run.nreq / sec, (cnt.update - cnt0.update) / sec,
+	       (cnt.sync - cnt0.sync) / sec, cnt.spin - cnt0.spin);
+	printf("%7.2f %7.2f %7.2f %8.1f %8.1f\n",
+	       percentile(50), percentile(99), (t2 - t1) / 1e6,
+	       Run.client / 1e6,
+	       (cnt.pixel - cnt0.pixel) * ScanByte / 1e6);
+
+	hostFinishScreen();
+	svgaStop();
+	return TRUE;
+}
+
+LOCAL	CONST	W	Bpp[] = {8, 16, 32};
+LOCAL	CONST	W	Entry[] = {0, 4, 64, 512, -1};
+LOCAL	CONST	W	Pace[] = {0, 60};
+
+/* each configuration in its own process, driver state starts from scratch */
+LOCAL	void	forkBench(W wl, W bpp, W entry, W pace)
+{
+	W	sts;
+	pid_t	pid;
+
+	fflush(stdout);
+	pid = fork();
+	if (pid == 0) {
+		sts = runBench(wl, bpp, entry, pace);
+		fflush(stdout);
+		_exit(sts ? 0 : 1);
+	}
+	if (pid < 0 || waitpid(pid, &sts, 0) < 0 ||
+	    !WIFEXITED(sts) || WEXITSTATUS(sts)) {
+		printf("%-7s %3d %5d %4d failed\n",
+		       Workload[wl].name, bpp, entry, pace);
+	}
+	return;
+}
+
+int	main(int ac, char *av[])
+{
+	W	wl, b, e, p;
+
+	printf("%-7s %3s %5s %4s %8s %7s %7s %9s %7s %7s %7s %8s %8s\n",
+	       "", "bpp", "entry", "pace", "req/s", "upd/s", "sync/s", "spin",
+	       "p50(us)", "p99(us)", "drain", "client", "device");
+	printf("%-7s %3s %5s %4s %8s %7s %7s %9s %7s %7s %7s %8s %8s\n",
+	       "", "", "", "(Hz)", "", "", "", "", "", "", "(ms)", "(MB)",
+	       "(MB)");
+
+	for (wl = 0; wl < NUM_WORKLOAD; wl++) {
+		if (ac > 1 && strcmp((char *)Workload[wl].name, av[1])) continue;
+
+		for (b = 0; b < sizeof(Bpp) / sizeof(Bpp[0]); b++) {
+			for (e = 0; e < sizeof(Entry) / sizeof(Entry[0]); e++) {
+				for (p = 0; p < sizeof(Pace) / sizeof(Pace[0]); p++) {
+					/* pacing needs damage tracking */
+					if (Entry[e] == 0 && Pace[p] > 0) continue;
+					forkBench(wl, Bpp[b], Entry[e], Pace[p]);
+				}
+			}
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,106 @@
+/*
+	cpu.c		host harness
+	privileged CPU operations of the driver (src/cpu.h), emulated
+
+		* MTRR: 8 variable ranges with write-combining, #0 is
+		  write-back for the lowest 2GB as firmware sets it
+		* CR4 says the OS saves SSE state, as the host does
+		* MTRR written with caches enabled is counted (Intel SDM
+		  11.11.7.2 wants CR0.CD set)
+
+	Copyright 2026 by agent
+	This software is distributed under the T-License 2.0.
+*/
+#include <basic.h>
+#include <string.h>
+#include "host.h"
+
+#define	MSR_MTRRCAP		0x0fe
+#define	MSR_MTRRPHYSBASE0	0x200
+#define	MTRR_VCNT		8
+
+#define	MTRRCAP_WC		(1 << 10)
+#define	MTRR_TYPE_WB		0x06
+#define	MTRR_VALID		(1 << 11)
+
+#define	CR0_PE			(1 << 0)
+#define	CR0_PG			(1U << 31)
+#define	CR0_CD			(1 << 30)
+#define	CR4_OSFXSR		(1 << 9)
+
+LOCAL	HostCpu	Cpu = {
+	.cr0 = CR0_PE | CR0_PG,
+	.physbase = {0x00000000 | MTRR_TYPE_WB},
+	.physmask = {0xf80000000ULL | MTRR_VALID},	/* 2GB, 36bit */
+};
+
+/* MTRR index of MSR, -1 if it is not a range register */
+LOCAL	W	mtrrIndex(UW msr)
+{
+	return (msr >= MSR_MTRRPHYSBASE0 &&
+		msr < MSR_MTRRPHYSBASE0 + MTRR_VCNT * 2) ?
+		msr - MSR_MTRRPHYSBASE0 : -1;
+}
+
+EXPORT	UD	rdmsr(UW msr)
+{
+	W	i;
+
+	if (msr == MSR_MTRRCAP) return MTRRCAP_WC | MTRR_VCNT;
+
+	if ((i = mtrrIndex(msr)) < 0) return 0;
+	return (i & 1) ? Cpu.physmask[i / 2] : Cpu.physbase[i / 2];
+}
+
+EXPORT	void	wrmsr(UW msr, UD val)
+{
+	W	i;
+
+	if ((i = mtrrIndex(msr)) < 0) return;
+	if (i & 1) Cpu.physmask[i / 2] = val;
+	else Cpu.physbase[i / 2] = val;
+
+	if (!(Cpu.cr0 & CR0_CD)) Cpu.cached++;
+	return;
+}
+
+EXPORT	UW	getCR0(void)
+{
+	return Cpu.cr0;
+}
+
+EXPORT	void	setCR0(UW cr0)
+{
+	Cpu.cr0 = cr0;
+	return;
+}
+
+EXPORT	UW	getCR4(void)
+{
+	return CR4_OSFXSR;
+}
+
+EXPORT	void	wbinvd(void)
+{
+	Cpu.wbinvd++;
+	return;
+}
+
+EXPORT	void	flushTLB(void)
+{
+	Cpu.tlbflush++;
+	return;
+}
+
+EXPORT	void	drainWC(void)
+{
+	__sync_synchronize();
+	__sync_fetch_and_add(&Cpu.drain, 1);
+	return;
+}
+
+EXPORT	void	hostCpu(HostCpu *cpu)
+{
+	*cpu = Cpu;
+	return;
+}
@@ -0,0 +1,308 @@
+/*
+	dispi.c		host harness
+	emulated Bochs Graphics Adapter: DISPI registers, VGA DAC and
+	input status, linear FrameBuffer
+
+		* registers follow Bochs: resolution is written while
+		  disabled, enabling sets the virtual screen to it and
+		  clears VRAM, GETCAPS makes resolution read the maximum
+		* vertical retrace is the last 1/12 of each frame at the
+		  given refresh rate (0: display is off, never in retrace)
+
+	Copyright 2026 by agent
+	This software is distributed under the T-License 2.0.
+*/
+#include <driver/driver.h>
+#include <stdlib.h>
+#include <string.h>
+#include "host.h"
+
+#define	DISPI_BASE	0x1ce		/* index, data */
+#define	VGA_BASE	0x3c0
+#define	LFB_PADDR	0xfd000000
+#define	LFB_SIZE	0x01000000	/* 16MB */
+
+#define	DISPI_ID	0xb0c5
+#define	MAX_XRES	2560
+#define	MAX_YRES	1600
+#define	MAX_BPP		32
+
+/* DISPI registers */
+#define	regID		0
+#define	regXRES		1
+#define	regYRES		2
+#define	regBPP		3
+#define	regENABLE	4
+#define	regBANK		5
+#define	regVIRT_WIDTH	6
+#define	regVIRT_HEIGHT	7
+#define	regX_OFFSET	8
+#define	regY_OFFSET	9
+#define	regVIDEO_MEMORY_64K	10
+#define	NUM_REG		11
+
+#define	ENABLED		0x01
+#define	GETCAPS		0x02
+#define	NOCLEARMEM	0x80
+
+/* VGA ports (offset from VGA_BASE) */
+#define	vgaDAC_WINDEX	0x08
+#define	vgaDAC_DATA	0x09
+#define	vgaSTATUS1	0x1a
+#define	VRETRACE	0x08
+
+#define	RETRACE_DIV	12		/* retrace is 1/12 of a frame */
+
+LOCAL	struct {
+	pthread_mutex_t	mtx;
+	W		refresh;
+	UD		start;		/* origin of frame timing */
+
+	UB		*vram;
+	HostIO		dispi;
+	HostIO		vga;
+
+	UW		index;
+	UH		reg[NUM_REG];
+	BOOL		getcaps;
+	UB		dacidx;
+	W		dacsub;
+
+	DispiState	st;
+} Dispi;
+
+/* ------------------------------------------------------------------------ */
+/*
+	DISPI index / data
+*/
+LOCAL	W	pitch(void)
+{
+	return Dispi.reg[regVIRT_WIDTH] * ((Dispi.reg[regBPP] + 7) / 8);
+}
+
+/* virtual screen and offsets are kept inside VRAM */
+LOCAL	void	fitVirtual(void)
+{
+	W	h;
+
+	if (pitch() <= 0) return;
+
+	h = LFB_SIZE / pitch();
+	if (Dispi.reg[regVIRT_HEIGHT] > h) Dispi.reg[regVIRT_HEIGHT] = h;
+	if (Dispi.reg[regVIRT_HEIGHT] < Dispi.reg[regYRES])
+		Dispi.reg[regVIRT_HEIGHT] = Dispi.reg[regYRES];
+	return;
+}
+
+LOCAL	UH	readDispi(UW index)
+{
+	switch (index) {
+	case regXRES:
+		if (Dispi.getcaps) return MAX_XRES;
+		break;
+	case regYRES:
+		if (Dispi.getcaps) return MAX_YRES;
+		break;
+	case regBPP:
+		if (Dispi.getcaps) return MAX_BPP;
+		break;
+	case regID:
+		return DISPI_ID;
+	case regVIDEO_MEMORY_64K:
+		return LFB_SIZE >> 16;
+	}
+	return (index < NUM_REG) ? Dispi.reg[index] : 0xffff;
+}
+
+LOCAL	void	writeDispi(UW index, UH data)
+{
+	W	bytes;
+
+	switch (index) {
+	case regXRES:
+	case regYRES:
+	case regBPP:
+		/* ignored while enabled */
+		if (Dispi.reg[regENABLE] & ENABLED) return;
+		if ((index == regXRES && (data == 0 || data > MAX_XRES)) ||
+		    (index == regYRES && (data == 0 || data > MAX_YRES)) ||
+		    (index == regBPP && data != 8 && data != 15 &&
+		     data != 16 && data != 24 && data != 32)) return;
+		break;
+
+	case regENABLE:
+		Dispi.getcaps = (data & GETCAPS) != 0;
+		if ((data & ENABLED) && !(Dispi.reg[regENABLE] & ENABLED)) {
+			Dispi.reg[regVIRT_WIDTH] = Dispi.reg[regXRES];
+			Dispi.reg[regVIRT_HEIGHT] = Dispi.reg[regYRES];
+			Dispi.reg[regX_OFFSET] = Dispi.reg[regY_OFFSET] = 0;
+			if (!(data & NOCLEARMEM)) memset(Dispi.vram, 0, LFB_SIZE);
+			Dispi.st.modeset++;
+		}
+		break;
+
+	case regVIRT_WIDTH:
+		/* rejected if the screen does not fit */
+		bytes = (Dispi.reg[regBPP] + 7) / 8;
+		if (data < Dispi.reg[regXRES] ||
+		    (W)data * bytes * Dispi.reg[regYRES] > LFB_SIZE) return;
+		Dispi.reg[index] = data;
+		fitVirtual();
+		return;
+
+	case regVIRT_HEIGHT:
+		Dispi.reg[index] = data;
+		fitVirtual();
+		return;
+
+	case regX_OFFSET:
+	case regY_OFFSET:
+		break;
+
+	default:
+		return;				/* read only, not emulated */
+	}
+	Dispi.reg[index] = data;
+	return;
+}
+
+LOCAL	UW	dispiIn(UW ofs)
+{
+	UW	v;
+
+	pthread_mutex_lock(&Dispi.mtx);
+	v = (ofs == 0) ? Dispi.index : readDispi(Dispi.index);
+	pthread_mutex_unlock(&Dispi.mtx);
+
+	return v;
+}
+
+LOCAL	void	dispiOut(UW ofs, UW data)
+{
+	pthread_mutex_lock(&Dispi.mtx);
+	if (ofs == 0) Dispi.index = data & 0xffff;
+	else writeDispi(Dispi.index, data);
+	pthread_mutex_unlock(&Dispi.mtx);
+	return;
+}
+
+/* ------------------------------------------------------------------------ */
+/*
+	VGA: DAC (8bit, enabled by DISPI) and input status #1
+*/
+LOCAL	BOOL	inRetrace(void)
+{
+	UD	period, phase;
+
+	if (Dispi.refresh <= 0) return FALSE;
+
+	period = 1000000000ULL / Dispi.refresh;
+	phase = (hostClock() - Dispi.start) % period;
+	return phase >= period - period / RETRACE_DIV;
+}
+
+LOCAL	UW	vgaIn(UW ofs)
+{
+	UW	v;
+
+	pthread_mutex_lock(&Dispi.mtx);
+	if (ofs == vgaSTATUS1) {
+		Dispi.st.statusrd++;
+		v = inRetrace() ? VRETRACE : 0;
+	} else {
+		v = 0xff;
+	}
+	pthread_mutex_unlock(&Dispi.mtx);
+
+	return v;
+}
+
+LOCAL	void	vgaOut(UW ofs, UW data)
+{
+	W	shift;
+
+	pthread_mutex_lock(&Dispi.mtx);
+	switch (ofs) {
+	case vgaDAC_WINDEX:
+		Dispi.dacidx = data;
+		Dispi.dacsub = 0;
+		break;
+	case vgaDAC_DATA:
+		/* red, green, blue, then next entry */
+		shift = (2 - Dispi.dacsub) * 8;
+		Dispi.st.palette[Dispi.dacidx] &= ~(0xffU << shift);
+		Dispi.st.palette[Dispi.dacidx] |= (data & 0xff) << shift;
+		if (++Dispi.dacsub == 3) {
+			Dispi.dacsub = 0;
+			Dispi.dacidx++;
+			Dispi.st.dacwrite++;
+		}
+		break;
+	}
+	pthread_mutex_unlock(&Dispi.mtx);
+	return;
+}
+
+/* ------------------------------------------------------------------------ */
+/*
+	set up the device (PCI, FrameBuffer, ports)
+*/
+EXPORT	void	dispiStart(W refresh)
+{
+	UW	bar[3];
+
+	memset(&Dispi, 0, sizeof(Dispi));
+	pthread_mutex_init(&Dispi.mtx, NULL);
+	Dispi.refresh = refresh;
+	Dispi.start = hostClock();
+
+	if (posix_memalign((void **)&Dispi.vram, 4096, LFB_SIZE) != 0) {
+		fprintf(stderr, "dispi: no memory\n");
+		exit(1);
+	}
+	memset(Dispi.vram, 0, LFB_SIZE);
+	Dispi.reg[regXRES] = 640;
+	Dispi.reg[regYRES] = 480;
+	Dispi.reg[regBPP] = 8;
+
+	hostAddRegion(LFB_PADDR, LFB_SIZE, Dispi.vram);
+
+	Dispi.dispi.base = DISPI_BASE;
+	Dispi.dispi.size = 2;
+	Dispi.dispi.in = dispiIn;
+	Dispi.dispi.out = dispiOut;
+	hostAddIO(&Dispi.dispi);
+
+	Dispi.vga.base = VGA_BASE;
+	Dispi.vga.size = 0x20;
+	Dispi.vga.in = vgaIn;
+	Dispi.vga.out = vgaOut;
+	hostAddIO(&Dispi.vga);
+
+	bar[0] = LFB_PADDR | 0x08;	/* prefetchable */
+	bar[1] = bar[2] = 0;
+	hostAddPci(0x1234, 0x1111, bar, 0);
+	return;
+}
+
+EXPORT	void	dispiState(DispiState *st)
+{
+	pthread_mutex_lock(&Dispi.mtx);
+	*st = Dispi.st;
+	st->xres = Dispi.reg[regXRES];
+	st->yres = Dispi.reg[regYRES];
+	st->bpp = Dispi.reg[regBPP];
+	st->enable = Dispi.reg[regENABLE];
+	st->virtw = Dispi.reg[regVIRT_WIDTH];
+	st->virth = Dispi.reg[regVIRT_HEIGHT];
+	st->xofs = Dispi.reg[regX_OFFSET];
+	st->yofs = Dispi.reg[regY_OFFSET];
+	pthread_mutex_unlock(&Dispi.mtx);
+	return;
+}
+
+/* pixel row y of VRAM (virtual screen) */
+EXPORT	UB	*dispiVRAM(W y)
+{
+	return Dispi.vram + y * pitch();
+}
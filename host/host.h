@@ -0,0 +1,112 @@
+/*
+	host.h		host harness
+	services of the harness itself, not seen by the driver
+
+	Copyright 2026 by agent
+	This software is distributed under the T-License 2.0.
+*/
+#include <basic.h>
+
+/*
+	tkernel.c: kernel emulation
+*/
+/* device configuration (GetDevConf), n values */
+IMPORT	void	hostSetConf(CONST B *name, W n, ...);
+IMPORT	void	hostClearConf(void);
+
+/* "physical" memory of a device, found by MapMemory() */
+IMPORT	void	hostAddRegion(UW paddr, W size, void *laddr);
+
+/* I/O ports of a device */
+typedef struct {
+	UW	base;
+	W	size;
+	UW	(*in)(UW ofs);
+	void	(*out)(UW ofs, UW data);
+} HostIO;
+
+IMPORT	void	hostAddIO(HostIO *io);
+
+/* PCI device, BAR #0-2 and interrupt line */
+IMPORT	void	hostAddPci(UH vendor, UH device, UW *bar, UB intline);
+
+/* request to the screen driver through its port (DC_READ, DC_WRITE...) */
+IMPORT	ERR	hostDevReq(W cmd, W datano, void *buf, W size, W *asize);
+
+/* raise interrupt, handler runs with interrupts disabled */
+IMPORT	void	hostRaiseInt(UINT intvec);
+
+/* monotonic time (nsec) */
+IMPORT	UD	hostClock(void);
+
+/* run fn in a child process (fresh driver state), TRUE if it passed */
+IMPORT	BOOL	hostRun(CONST B *name, BOOL (*fn)(void));
+
+/*
+	svga.c: emulated VMware SVGA II
+*/
+typedef struct {
+	UW	cap;		/* regCAP                              */
+	BOOL	fence;		/* FIFO has fence (fifoCAP_FENCE)      */
+	W	refresh;	/* FIFO is processed at least this
+				   often (msec), as a display refresh  */
+	W	cmdcost;	/* host time per command (nsec)        */
+	W	pixcost;	/* host time per 1024 updated pixels   */
+} SvgaConf;
+
+typedef struct {
+	UW	cmd;		/* commands processed                  */
+	UW	update;		/* fifoCMD_UPDATE                      */
+	UD	pixel;		/* pixels updated                      */
+	UW	fence;		/* fences passed                       */
+	UW	sync;		/* regSYNC writes                      */
+	UW	irq;		/* interrupts raised                   */
+	UW	error;		/* malformed commands                  */
+	UW	spin;		/* regBUSY read while busy (polled)    */
+} SvgaCount;
+
+IMPORT	void	svgaStart(SvgaConf *conf);
+IMPORT	void	svgaStop(void);
+IMPORT	void	svgaCount(SvgaCount *cnt);
+IMPORT	void	svgaHook(void (*fn)(UW *cmd, W len));
+IMPORT	UB	*svgaVRAM(W *pitch);
+
+/*
+	dispi.c: emulated Bochs Graphics Adapter
+*/
+typedef struct {
+	UH	xres, yres, bpp;	/* DISPI registers                 */
+	UH	enable;
+	UH	virtw, virth;
+	UH	xofs, yofs;
+	UW	palette[256];	/* DAC, 0x00RRGGBB                     */
+	UW	dacwrite;	/* DAC entries written                 */
+	UW	statusrd;	/* input status #1 reads               */
+	UW	modeset;	/* enabled with a new resolution       */
+} DispiState;
+
+IMPORT	void	dispiStart(W refresh);
+IMPORT	void	dispiState(DispiState *st);
+IMPORT	UB	*dispiVRAM(W y);
+
+/*
+	cpu.c: privileged CPU operations (src/cpu.h)
+*/
+typedef struct {
+	UW	cr0;
+	UD	physbase[8];	/* variable range MTRR                 */
+	UD	physmask[8];
+	UW	cached;		/* MTRR written with caches enabled    */
+	UW	wbinvd;
+	UW	tlbflush;
+	UW	drain;		/* write-combining buffer drained      */
+} HostCpu;
+
+IMPORT	void	hostCpu(HostCpu *cpu);
+
+/*
+	hostscr.c: the screen driver started and stopped as the system
+	does (main), requests go through its port
+*/
+IMPORT	ERR	hostInitScreen(void);
+IMPORT	void	hostFinishScreen(void);
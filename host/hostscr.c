@@ -0,0 +1,31 @@
+/*
+	hostscr.c	host harness
+	the screen driver started and stopped as the system does
+
+		* main() of main.c is built as screenMain() (Makefile), it
+		  creates the port and workers, runs initSCREEN() and
+		  registers the device
+		* requests go through the port (hostDevReq)
+
+	Copyright 2026 by agent
+	This software is distributed under the T-License 2.0.
+*/
+#include "screen.h"
+#include <tcode.h>
+#include "host.h"
+
+IMPORT	ERR	screenMain(Bool start, TC *arg);
+
+/* no argument: default task priority */
+LOCAL	TC	Arg[] = {TK_NULL};
+
+EXPORT	ERR	hostInitScreen(void)
+{
+	return screenMain(TRUE, Arg);
+}
+
+EXPORT	void	hostFinishScreen(void)
+{
+	screenMain(FALSE, Arg);
+	return;
+}
@@ -0,0 +1,91 @@
+/*
+	basic.h		host harness
+	T-Kernel basic types and error codes (LP64 host)
+
+	Copyright 2026 by agent
+	This software is distributed under the T-License 2.0.
+*/
+#ifndef __BASIC_H__
+#define __BASIC_H__
+
+#include <stddef.h>
+
+typedef signed char		B;
+typedef short			H;
+typedef int			W;
+typedef long long		D;
+typedef unsigned char		UB;
+typedef unsigned short		UH;
+typedef unsigned int		UW;
+typedef unsigned long long	UD;
+
+typedef volatile UB		_UB;
+typedef volatile UH		_UH;
+typedef volatile UW		_UW;
+typedef volatile W		_W;
+
+typedef int			INT;
+typedef unsigned int		UINT;
+typedef int			BOOL;
+typedef int			Bool;
+typedef unsigned short		TC;
+
+typedef int			ID;
+typedef int			RNO;
+typedef int			PRI;
+typedef int			TMO;
+typedef int			RELTIM;
+typedef int			DLYTIME;
+typedef int			CYCTIME;
+
+typedef int			ER;
+typedef int			ERR;
+typedef int			WERR;
+
+typedef W			(*FUNCP)();
+typedef W			(*FP)();
+
+#define	LOCAL		static
+#define	EXPORT
+#define	IMPORT		extern
+#define	CONST		const
+#define	Inline		static inline
+
+#define	TRUE		1
+#define	FALSE		0
+
+#define	TNULL		0
+#define	TC_NULL		0
+
+/* error codes (errno in the upper half, T-Kernel style) */
+#define	ERCD(er, ef)	((W)(((UW)(er) << 16) | ((ef) & 0xffff)))
+
+#define	E_OK		0
+#define	ER_OK		0
+#define	E_NOSPT		ERCD(-9, 0)
+#define	E_PAR		ERCD(-17, 0)
+#define	E_ID		ERCD(-18, 0)
+#define	E_NOMEM		ERCD(-33, 0)
+#define	E_LIMIT		ERCD(-34, 0)
+#define	E_OBJ		ERCD(-41, 0)
+#define	E_NOEXS		ERCD(-42, 0)
+#define	E_RLWAI		ERCD(-49, 0)
+#define	E_TMOUT		ERCD(-50, 0)
+#define	E_DLT		ERCD(-51, 0)
+
+#define	ER_NOSPT	E_NOSPT
+#define	ER_PAR		E_PAR
+#define	ER_NOMEM	E_NOMEM
+#define	ER_LIMIT	E_LIMIT
+#define	ER_OBJ		E_OBJ
+#define	ER_NOEXS	E_NOEXS
+#define	ER_TMOUT	E_TMOUT
+#define	ER_BUSY		ERCD(-64, 0)
+#define	ER_ADR		ERCD(-65, 0)
+#define	ER_NONE		ERCD(-66, 0)
+
+#define	EC_INNER	-1
+#define	EC_PAR		-2
+#define	ED_CMD		1
+
+#endif /* __BASIC_H__ */
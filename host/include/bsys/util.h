@@ -0,0 +1,4 @@
+/*
+	util.h	host harness
+	nothing is used from this header
+*/
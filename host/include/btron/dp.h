@@ -0,0 +1,4 @@
+/*
+	dp.h	host harness
+	nothing is used from this header
+*/
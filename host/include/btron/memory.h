@@ -0,0 +1,26 @@
+/*
+	memory.h	host harness
+	memory block allocation
+
+	Copyright 2026 by agent
+	This software is distributed under the T-License 2.0.
+*/
+#ifndef __BTRON_MEMORY_H__
+#define __BTRON_MEMORY_H__
+
+#include <basic.h>
+
+#define	M_SYSTEM	0x0001
+#define	M_RESIDENT	0x0002
+
+typedef struct {
+	W	blksz;		/* block size (byte) */
+	W	total;		/* total blocks */
+	W	free;		/* free blocks */
+} M_STATE;
+
+IMPORT	ER	b_mbk_sts(M_STATE *sts);
+IMPORT	ER	b_get_mbk(void *blk, W nblk, UW attr);
+IMPORT	ER	b_rel_mbk(void *blk);
+
+#endif /* __BTRON_MEMORY_H__ */
@@ -0,0 +1,74 @@
+/*
+	screen.h	host harness
+	screen device interface (device/screen.h of the SDK)
+
+	Copyright 2026 by agent
+	This software is distributed under the T-License 2.0.
+*/
+#ifndef __DEVICE_SCREEN_H__
+#define __DEVICE_SCREEN_H__
+
+#include <basic.h>
+
+typedef UW	COLOR;
+
+typedef union {
+	struct {
+		H	left, top, right, bottom;
+	} c;
+} RECT;
+
+typedef struct {
+	H	x, y;
+} PNT;
+
+typedef struct {
+	UW	planes;
+	H	pixbits;
+	H	rowbytes;
+	RECT	bounds;
+	UB	*baseaddr[1];
+} BMP;
+
+typedef struct {
+	H	attr;
+	H	planes;
+	H	pixbits;
+	H	hpixels;
+	H	vpixels;
+	H	hres;
+	H	vres;
+	H	color[4];
+	H	resv[6];
+} DEV_SPEC;
+
+/* DEV_SPEC attr */
+#define	DA_COLOR_RGB	0x0002
+#define	DA_HAVEBMP	0x0004
+#define	DA_HAVECMAP	0x0008
+
+typedef struct {
+	W	hpos, hsize, vpos, vsize;
+} ScrAdjust;
+
+typedef struct {
+	UB	name1[33];
+	UB	name2[33];
+	UB	name3[33];
+	void	*framebuf_addr;
+	W	framebuf_size;
+	W	mainmem_size;
+} ScrDevInfo;
+
+#define	DN_SCRSPEC	(-200)
+#define	DN_SCRLIST	(-201)
+#define	DN_SCRNO	(-202)
+#define	DN_SCRCOLOR	(-203)
+#define	DN_SCRBMP	(-204)
+#define	DN_SCRBRIGHT	(-300)
+#define	DN_SCRUPDFN	(-301)
+#define	DN_SCRVFREQ	(-302)
+#define	DN_SCRADJUST	(-303)
+#define	DN_SCRDEVINFO	(-310)
+
+#endif /* __DEVICE_SCREEN_H__ */
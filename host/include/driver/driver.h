@@ -0,0 +1,217 @@
+/*
+	driver.h	host harness
+	T-Kernel / device driver services used by the screen driver,
+	emulated with POSIX threads (tkernel.c)
+
+	Copyright 2026 by agent
+	This software is distributed under the T-License 2.0.
+*/
+#ifndef __DRIVER_DRIVER_H__
+#define __DRIVER_DRIVER_H__
+
+#include <basic.h>
+#include <stdio.h>
+#include <pthread.h>
+
+/* object attribute */
+#define	TA_NULL		0
+#define	TA_HLNG		0x00000001
+#define	TA_TFIFO	0x00000000
+#define	TA_WSGL		0x00000000
+#define	TA_WMUL		0x00000008
+#define	TA_STA		0x00000002
+#define	TA_PHS		0x00000004
+#define	TA_RNG0		0x00000000
+#define	TA_RNG1		0x00000100
+#define	TA_RNG2		0x00000200
+#define	TA_RNG3		0x00000300
+#define	TA_FPU		0x00001000
+
+#define	TMO_POL		0
+#define	TMO_FEVR	(-1)
+
+/* task */
+typedef struct {
+	void	*exinf;
+	UINT	tskatr;
+	void	(*task)();
+	PRI	itskpri;
+	W	stksz;
+} T_CTSK;
+
+IMPORT	ID	vcre_tsk(T_CTSK *ctsk);
+IMPORT	ER	sta_tsk(ID tskid, INT stacd);
+IMPORT	ER	ter_tsk(ID tskid);
+IMPORT	ER	del_tsk(ID tskid);
+IMPORT	void	exd_tsk(void);
+IMPORT	void	ext_tsk(void);
+IMPORT	ER	get_tid(ID *tskid);
+IMPORT	ER	slp_tsk(void);
+IMPORT	ER	tslp_tsk(TMO tmout);
+IMPORT	ER	wup_tsk(ID tskid);
+IMPORT	ER	dly_tsk(DLYTIME dlytim);
+
+/* event flag */
+typedef struct {
+	void	*exinf;
+	UINT	flgatr;
+	UINT	iflgptn;
+} T_CFLG;
+
+#define	TWF_ANDW	0x00
+#define	TWF_ORW		0x02
+#define	TWF_CLR		0x01
+
+IMPORT	ID	vcre_flg(T_CFLG *cflg);
+IMPORT	ER	del_flg(ID flgid);
+IMPORT	ER	set_flg(ID flgid, UINT setptn);
+IMPORT	ER	clr_flg(ID flgid, UINT clrptn);
+IMPORT	ER	twai_flg(UINT *p_flgptn, ID flgid, UINT waiptn, UINT wfmode,
+			 TMO tmout);
+IMPORT	ER	wai_flg(UINT *p_flgptn, ID flgid, UINT waiptn, UINT wfmode);
+
+/* rendezvous port */
+typedef struct {
+	void	*exinf;
+	UINT	poratr;
+	W	maxcmsz;
+	W	maxrmsz;
+} T_CPOR;
+
+IMPORT	ID	vcre_por(T_CPOR *cpor);
+IMPORT	ER	del_por(ID porid);
+IMPORT	W	cal_por(ID porid, UINT calptn, void *msg, W cmsgsz);
+IMPORT	ER	acp_por(RNO *rdvno, void *msg, W *cmsgsz, ID porid,
+			UINT acpptn);
+IMPORT	ER	rpl_rdv(RNO rdvno, void *msg, W rmsgsz);
+
+/* cyclic handler */
+typedef struct {
+	void	*exinf;
+	UINT	cycatr;
+	void	(*cychdr)();
+	CYCTIME	cyctim;
+	CYCTIME	cycphs;
+} T_CCYC;
+
+IMPORT	ID	vcre_cyc(T_CCYC *ccyc);
+IMPORT	ER	del_cyc(ID cycid);
+IMPORT	ER	sta_cyc(ID cycid);
+IMPORT	ER	stp_cyc(ID cycid);
+
+/* interrupt */
+typedef struct {
+	UINT	intatr;
+	void	(*inthdr)(UINT dintno);
+} T_DINT;
+
+#define	IV_IRQ(n)	(0x20 + (n))
+#define	IM_LEVEL	0x02
+#define	IM_ENA		0x00
+
+IMPORT	ER	def_int(UINT dintno, T_DINT *pk_dint);
+IMPORT	void	SetIntMode(UINT intvec, UINT mode);
+IMPORT	void	EnableInt(UINT intvec);
+IMPORT	void	DisableInt(UINT intvec);
+IMPORT	void	EndOfInt(UINT intvec);
+
+/* interrupt disable: one lock for every emulated CPU */
+IMPORT	UINT	hostDI(void);
+IMPORT	void	hostEI(UINT imask);
+#define	DI(imask)	((imask) = hostDI())
+#define	EI(imask)	hostEI(imask)
+
+/* fast lock */
+typedef struct {
+	pthread_mutex_t	mtx;
+} FastLock;
+
+IMPORT	ER	CreateLockWN(FastLock *lock, CONST B *name);
+IMPORT	void	DeleteLock(FastLock *lock);
+IMPORT	void	Lock(FastLock *lock);
+IMPORT	void	Unlock(FastLock *lock);
+
+/* device configuration, values are given by the harness */
+#define	L_DEVCONF_VAL	64
+
+IMPORT	W	GetDevConf(CONST B *name, W *val);
+
+/* memory mapping, "physical" addresses belong to emulated devices */
+#define	MM_USER		0x0001
+#define	MM_SYSTEM	0x0002
+#define	MM_READ		0x0004
+#define	MM_WRITE	0x0008
+#define	MM_CDIS		0x0010
+
+IMPORT	ER	MapMemory(void *paddr, W len, UINT attr, void **laddr);
+IMPORT	ER	UnmapMemory(void *laddr);
+IMPORT	W	CnvPhysicalAddr(void *laddr, W len, void **paddr);
+
+/* device driver: requests come through the rendezvous port */
+#define	D_NORM_PTN	0x01	/* rendezvous of ordinary request */
+#define	D_ABORT_PTN	0x02	/* rendezvous of abort request */
+
+#define	DC_READ		1
+#define	DC_WRITE	2
+#define	DC_OPEN		3
+#define	DC_CLOSE	4
+#define	DC_CLOSEALL	5
+#define	DC_ABORT	6
+#define	DC_SUSPEND	7
+#define	DC_RESUME	8
+
+#define	DK_UNDEF	0
+
+typedef struct {
+	UW	cmd:8;		/* DC_xxx */
+	UW	adcnv:1;	/* memptr is in the caller's space */
+	UW	rsv:23;
+} DevCmd;
+
+typedef struct {
+	DevCmd	cmd;
+	ID	devid;
+	ID	taskid;		/* caller */
+	W	datano;
+	W	datacnt;
+	void	*memptr;
+} DevReq;
+
+typedef struct {
+	ID	devid;
+	DevCmd	cmd;
+	W	datano;
+	W	datacnt;	/* size read / written */
+	union {
+		ERR	err;
+	} error;
+} DevRsp;
+
+typedef struct {
+	struct {
+		UW	devinfo:4;
+		UW	devkind:4;
+		UW	reserved:4;
+		UW	openreq:1;
+		UW	lockreq:1;
+		UW	diskinfo:1;
+		UW	chardev:1;
+		UW	nowait:1;
+		UW	eject:1;
+	} attr;
+	W	subunits;
+	TC	name[8];
+	ID	portid;		/* -1: unregister */
+} DevDef;
+
+IMPORT	ER	DefDevice(CONST DevDef *ddef, void *rsv);
+
+/* caller's address space, every task shares one on the host */
+IMPORT	ER	SetTaskSpace(ID tskid);
+IMPORT	ER	CheckSpaceR(void *addr, W len);
+IMPORT	ER	CheckSpaceRW(void *addr, W len);
+
+#define	CH4toW(c1, c2, c3, c4)	(((c1) << 24) | ((c2) << 16) | \
+				 ((c3) << 8) | (c4))
+
+#endif /* __DRIVER_DRIVER_H__ */
@@ -0,0 +1,24 @@
+/*
+	pci.h		host harness
+	PCI configuration space of emulated devices (svga.c)
+
+	Copyright 2026 by agent
+	This software is distributed under the T-License 2.0.
+*/
+#ifndef __DRIVER_PCAT_PCI_H__
+#define __DRIVER_PCAT_PCI_H__
+
+#include <basic.h>
+
+#define	PCR_COMMAND	0x04
+#define	PCR_BASEADDR_0	0x10
+#define	PCR_BASEADDR_1	0x14
+#define	PCR_BASEADDR_2	0x18
+
+IMPORT	W	searchPciDev(UH vendor, UH device);
+IMPORT	UB	inPciConfB(W pciaddr, W reg);
+IMPORT	UH	inPciConfH(W pciaddr, W reg);
+IMPORT	UW	inPciConfW(W pciaddr, W reg);
+IMPORT	void	outPciConfH(W pciaddr, W reg, UH data);
+
+#endif /* __DRIVER_PCAT_PCI_H__ */
@@ -0,0 +1,20 @@
+/*
+	sys.h		host harness
+	I/O port access, routed to emulated devices (svga.c)
+
+	Copyright 2026 by agent
+	This software is distributed under the T-License 2.0.
+*/
+#ifndef __DRIVER_PCAT_SYS_H__
+#define __DRIVER_PCAT_SYS_H__
+
+#include <basic.h>
+
+IMPORT	void	out_w(UW port, UW data);
+IMPORT	UW	in_w(UW port);
+IMPORT	void	out_h(UW port, UH data);
+IMPORT	UH	in_h(UW port);
+IMPORT	void	out_b(UW port, UB data);
+IMPORT	UB	in_b(UW port);
+
+#endif /* __DRIVER_PCAT_SYS_H__ */
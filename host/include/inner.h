@@ -0,0 +1,4 @@
+/*
+	inner.h	host harness
+	nothing is used from this header
+*/
@@ -0,0 +1,4 @@
+/*
+	segment.h	host harness
+	nothing is used from this header
+*/
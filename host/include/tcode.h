@@ -0,0 +1,35 @@
+/*
+	tcode.h		host harness
+	TRON code of the characters the screen driver uses
+
+	Copyright 2026 by agent
+	This software is distributed under the T-License 2.0.
+*/
+#ifndef __TCODE_H__
+#define __TCODE_H__
+
+#define	TK_NULL		0x0000
+#define	TK_KSP		0x2121		/* full width space */
+#define	TK_COLN		0x2127		/* : */
+#define	TK_EXCL		0x212a		/* ! */
+
+#define	TK_0		0x2330
+#define	TK_1		0x2331
+#define	TK_2		0x2332
+#define	TK_3		0x2333
+#define	TK_4		0x2334
+#define	TK_5		0x2335
+#define	TK_6		0x2336
+#define	TK_7		0x2337
+#define	TK_8		0x2338
+#define	TK_9		0x2339
+
+#define	TK_C		0x2343
+#define	TK_E		0x2345
+#define	TK_K		0x234b
+#define	TK_M		0x234d
+#define	TK_N		0x234e
+#define	TK_R		0x2352
+#define	TK_S		0x2353
+
+#endif /* __TCODE_H__ */
@@ -0,0 +1,15 @@
+/*
+	tstring.h	host harness
+	TRON code string functions (tkernel.c)
+
+	Copyright 2026 by agent
+	This software is distributed under the T-License 2.0.
+*/
+#ifndef __TSTRING_H__
+#define __TSTRING_H__
+
+#include <basic.h>
+
+IMPORT	long	tc_strtol(CONST TC *str, TC **endptr, int base);
+
+#endif /* __TSTRING_H__ */
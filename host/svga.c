@@ -0,0 +1,533 @@
+/*
+	svga.c		host harness
+	emulated VMware SVGA II: registers, FIFO consumer, 2D commands
+
+	Copyright 2026 by agent
+	This software is distributed under the T-License 2.0.
+*/
+#include <driver/driver.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "host.h"
+
+#define	IOBASE		0x1070
+#define	FB_PADDR	0xe0000000
+#define	FB_SIZE		0x01000000	/* 16MB */
+#define	FIFO_PADDR	0xfe000000
+#define	FIFO_SIZE	0x00010000
+#define	IRQ		11
+
+#define	MAX_WIDTH	2560
+#define	MAX_HEIGHT	1600
+
+/* registers (subset the driver uses) */
+#define	regID		0
+#define	regENABLE	1
+#define	regWIDTH	2
+#define	regHEIGHT	3
+#define	regMAX_WIDTH	4
+#define	regMAX_HEIGHT	5
+#define	regBPP		7
+#define	regPITCH	12
+#define	regVRAMSIZE	15
+#define	regCAP		17
+#define	regFIFOSIZE	19
+#define	regCONFIG	20
+#define	regSYNC		21
+#define	regBUSY		22
+#define	regCURSOR_ID	24
+#define	regCURSOR_X	25
+#define	regCURSOR_Y	26
+#define	regCURSOR_ON	27
+#define	regIRQMASK	33
+#define	regPALETTE	1024
+#define	NUM_REG		(regPALETTE + 256 * 3)
+
+#define	regID_MAGIC(x)	(0x90000000 | (x))
+
+#define	portINDEX	0
+#define	portVALUE	1
+#define	portIRQSTATUS	8
+#define	irqANY_FENCE	(1 << 0)
+
+#define	fifoMIN		0
+#define	fifoMAX		1
+#define	fifoNEXT	2
+#define	fifoSTOP	3
+#define	fifoCAP		4
+#define	fifoFENCE	6
+#define	fifoBUSY	290
+
+#define	fifoCAP_FENCE	(1 << 0)
+
+#define	cmdUPDATE	1
+#define	cmdRECT_FILL	2
+#define	cmdRECT_COPY	3
+#define	cmdRECT_ROP_COPY	14
+#define	cmdDEFINE_ALPHA_CURSOR	22
+#define	cmdFENCE	30
+
+#define	CMD_MAXLEN	(6 + 64 * 64)	/* words of the longest command */
+#define	COST_SLEEP	100000		/* owed time is slept in this unit */
+
+LOCAL	struct {
+	SvgaConf	conf;
+	pthread_t	th;
+	pthread_mutex_t	mtx;		/* registers, flags, counters */
+	pthread_cond_t	cv;
+	BOOL		run;
+
+	UB		*vram;
+	_UW		*fifo;
+	HostIO		io;
+
+	UW		index;
+	UW		reg[NUM_REG];
+	UW		irqstatus;
+	BOOL		syncreq;	/* regSYNC written since last pass */
+	BOOL		busy;		/* regBUSY */
+
+	SvgaCount	cnt;
+	void		(*hook)(UW *cmd, W len);
+
+	UD		owed;		/* emulated host time (nsec) */
+	UW		cmd[CMD_MAXLEN];
+} Svga;
+
+/* ------------------------------------------------------------------------ */
+/*
+	I/O port: index / value pair and interrupt status
+*/
+LOCAL	UW	readReg(UW index)
+{
+	switch (index) {
+	case regPITCH:
+		return Svga.reg[regWIDTH] * ((Svga.reg[regBPP] + 7) / 8);
+	case regBUSY:
+		if (Svga.busy) Svga.cnt.spin++;
+		return Svga.busy;
+	}
+	return (index < NUM_REG) ? Svga.reg[index] : 0;
+}
+
+LOCAL	void	writeReg(UW index, UW data)
+{
+	switch (index) {
+	case regID:
+		/* protocol #0-2 are understood */
+		if ((data & ~3) == regID_MAGIC(0) && (data & 3) <= 2)
+			Svga.reg[regID] = data;
+		return;
+	case regSYNC:
+		Svga.syncreq = TRUE;
+		Svga.busy = TRUE;
+		Svga.cnt.sync++;
+		pthread_cond_signal(&Svga.cv);
+		return;
+	case regWIDTH:
+		if (data > MAX_WIDTH) data = MAX_WIDTH;
+		break;
+	case regHEIGHT:
+		if (data > MAX_HEIGHT) data = MAX_HEIGHT;
+		break;
+	case regCONFIG:
+		pthread_cond_signal(&Svga.cv);
+		break;
+	case regMAX_WIDTH:
+	case regMAX_HEIGHT:
+	case regVRAMSIZE:
+	case regCAP:
+	case regFIFOSIZE:
+	case regBUSY:
+		return;				/* read only */
+	}
+	if (index < NUM_REG) Svga.reg[index] = data;
+	return;
+}
+
+LOCAL	UW	svgaIn(UW ofs)
+{
+	UW	v;
+
+	pthread_mutex_lock(&Svga.mtx);
+	switch (ofs) {
+	case portINDEX:
+		v = Svga.index;
+		break;
+	case portVALUE:
+		v = readReg(Svga.index);
+		break;
+	case portIRQSTATUS:
+		v = Svga.irqstatus;
+		break;
+	default:
+		v = ~0U;
+		break;
+	}
+	pthread_mutex_unlock(&Svga.mtx);
+
+	return v;
+}
+
+LOCAL	void	svgaOut(UW ofs, UW data)
+{
+	pthread_mutex_lock(&Svga.mtx);
+	switch (ofs) {
+	case portINDEX:
+		Svga.index = data;
+		break;
+	case portVALUE:
+		writeReg(Svga.index, data);
+		break;
+	case portIRQSTATUS:
+		Svga.irqstatus &= ~data;	/* acknowledge */
+		break;
+	}
+	pthread_mutex_unlock(&Svga.mtx);
+	return;
+}
+
+/* ------------------------------------------------------------------------ */
+/*
+	2D commands, drawn in VRAM with the current mode
+*/
+LOCAL	W	pixByte(void)
+{
+	return (Svga.reg[regBPP] + 7) / 8;
+}
+
+/* TRUE if rectangle is inside the screen */
+LOCAL	BOOL	inScreen(UW x, UW y, UW w, UW h)
+{
+	return (x <= Svga.reg[regWIDTH] && w <= Svga.reg[regWIDTH] - x &&
+		y <= Svga.reg[regHEIGHT] && h <= Svga.reg[regHEIGHT] - y);
+}
+
+LOCAL	void	rectFill(UW color, UW x, UW y, UW w, UW h)
+{
+	W	i, j, pb, pitch;
+	UB	*p;
+
+	pb = pixByte();
+	pitch = readReg(regPITCH);
+	for (j = 0; j < h; j++) {
+		p = Svga.vram + (y + j) * pitch + x * pb;
+		for (i = 0; i < w; i++, p += pb) memcpy(p, &color, pb);
+	}
+	return;
+}
+
+/* d = rop(s, d) for each bit, X11 GXxxx */
+Inline	UB	ropByte(UB s, UB d, UW rop)
+{
+	UB	r = 0;
+
+	if (rop & 1) r |= s & d;
+	if (rop & 2) r |= s & ~d;
+	if (rop & 4) r |= ~s & d;
+	if (rop & 8) r |= ~s & ~d;
+	return r;
+}
+
+LOCAL	void	rectCopy(UW sx, UW sy, UW dx, UW dy, UW w, UW h, UW rop)
+{
+	W	i, j, y, pb, pitch, len;
+	UB	*s, *d;
+
+	pb = pixByte();
+	pitch = readReg(regPITCH);
+	len = w * pb;
+
+	/* overlapping copy: rows in the other direction */
+	for (j = 0; j < h; j++) {
+		y = (dy > sy) ? h - 1 - j : j;
+		s = Svga.vram + (sy + y) * pitch + sx * pb;
+		d = Svga.vram + (dy + y) * pitch + dx * pb;
+		if (rop == 3) {
+			memmove(d, s, len);
+		} else if (d <= s) {
+			for (i = 0; i < len; i++)
+				d[i] = ropByte(s[i], d[i], rop);
+		} else {
+			for (i = len - 1; i >= 0; i--)
+				d[i] = ropByte(s[i], d[i], rop);
+		}
+	}
+	return;
+}
+
+/* emulated processing time */
+LOCAL	void	spend(UD nsec)
+{
+	struct timespec	ts;
+
+	Svga.owed += nsec;
+	if (Svga.owed < COST_SLEEP) return;
+
+	ts.tv_sec = Svga.owed / 1000000000;
+	ts.tv_nsec = Svga.owed % 1000000000;
+	nanosleep(&ts, NULL);
+	Svga.owed = 0;
+	return;
+}
+
+/* number of words of the command at the top, 0: not known */
+LOCAL	W	cmdLength(UW *cmd, W avail)
+{
+	switch (cmd[0]) {
+	case cmdUPDATE:
+		return 5;
+	case cmdRECT_FILL:
+		return 6;
+	case cmdRECT_COPY:
+		return 7;
+	case cmdRECT_ROP_COPY:
+		return 8;
+	case cmdFENCE:
+		return 2;
+	case cmdDEFINE_ALPHA_CURSOR:
+		if (avail < 6) return 6;
+		if (cmd[4] > 64 || cmd[5] > 64) return 0;
+		return 6 + cmd[4] * cmd[5];
+	}
+	return 0;
+}
+
+/* execute one command, FALSE if it is malformed */
+LOCAL	BOOL	execCmd(UW *c, W len)
+{
+	UD	px;
+
+	switch (c[0]) {
+	case cmdUPDATE:
+		if (!inScreen(c[1], c[2], c[3], c[4])) return FALSE;
+		px = (UD)c[3] * c[4];
+		Svga.cnt.update++;
+		Svga.cnt.pixel += px;
+		spend(px * Svga.conf.pixcost / 1024);
+		break;
+	case cmdRECT_FILL:
+		if (!inScreen(c[2], c[3], c[4], c[5])) return FALSE;
+		rectFill(c[1], c[2], c[3], c[4], c[5]);
+		break;
+	case cmdRECT_COPY:
+	case cmdRECT_ROP_COPY:
+		if (!inScreen(c[1], c[2], c[5], c[6]) ||
+		    !inScreen(c[3], c[4], c[5], c[6]) ||
+		    (c[0] == cmdRECT_ROP_COPY && c[7] > 15)) return FALSE;
+		rectCopy(c[1], c[2], c[3], c[4], c[5], c[6],
+			 (c[0] == cmdRECT_COPY) ? 3 : c[7]);
+		break;
+	case cmdDEFINE_ALPHA_CURSOR:
+		if (c[4] == 0 || c[5] == 0 || c[2] >= c[4] || c[3] >= c[5])
+			return FALSE;
+		break;
+	case cmdFENCE:
+		Svga.fifo[fifoFENCE] = c[1];
+		Svga.cnt.fence++;
+		break;
+	}
+	if (Svga.hook != NULL) (*Svga.hook)(c, len);
+	spend(Svga.conf.cmdcost);
+
+	return TRUE;
+}
+
+/*
+	process FIFO from fifoSTOP to fifoNEXT, TRUE if a fence passed
+		* fifoSTOP advances per command, so that the driver sees
+		  space as soon as it is free
+*/
+LOCAL	BOOL	processFIFO(void)
+{
+	W	min, max, stop, next, n, len, avail;
+	BOOL	fence = FALSE;
+
+	min = Svga.fifo[fifoMIN];
+	max = Svga.fifo[fifoMAX];
+	if (min < 4 * (fifoBUSY + 1) || max > FIFO_SIZE || min >= max ||
+	    (min & 3) || (max & 3)) {
+		Svga.cnt.error++;
+		return FALSE;
+	}
+
+	stop = Svga.fifo[fifoSTOP];
+	while ((next = __atomic_load_n(&Svga.fifo[fifoNEXT],
+				       __ATOMIC_ACQUIRE)) != stop) {
+		if (next < min || next >= max || (next & 3)) {
+			Svga.cnt.error++;
+			break;
+		}
+		avail = ((next - stop + max - min) % (max - min)) / 4;
+
+		/* gather words, command may wrap around */
+		len = 1;
+		for (n = 0; n < len; n++) {
+			if (n >= avail || n >= CMD_MAXLEN) break;
+			Svga.cmd[n] = Svga.fifo[stop / 4];
+			stop += 4;
+			if (stop >= max) stop = min;
+			if (n == 0 || n == 5) len = cmdLength(Svga.cmd, n + 1);
+		}
+		if (len == 0 || n < len) {
+			/* unknown command, or published partially */
+			Svga.cnt.error++;
+			__atomic_store_n(&Svga.fifo[fifoSTOP], next,
+					 __ATOMIC_RELEASE);
+			break;
+		}
+
+		Svga.cnt.cmd++;
+		if (!execCmd(Svga.cmd, len)) Svga.cnt.error++;
+		if (Svga.cmd[0] == cmdFENCE) fence = TRUE;
+		__atomic_store_n(&Svga.fifo[fifoSTOP], stop, __ATOMIC_RELEASE);
+	}
+
+	return fence;
+}
+
+/*
+	consumer: runs at regSYNC, and at each refresh like a display
+*/
+LOCAL	void	*svgaTask(void *arg)
+{
+	BOOL	sync, fence, irq;
+	struct timespec	ts;
+
+	pthread_mutex_lock(&Svga.mtx);
+	while (Svga.run) {
+		if (!Svga.syncreq) {
+			if (Svga.conf.refresh > 0) {
+				clock_gettime(CLOCK_MONOTONIC, &ts);
+				ts.tv_nsec += Svga.conf.refresh * 1000000L;
+				ts.tv_sec += ts.tv_nsec / 1000000000;
+				ts.tv_nsec %= 1000000000;
+				pthread_cond_timedwait(&Svga.cv, &Svga.mtx,
+						       &ts);
+			} else {
+				pthread_cond_wait(&Svga.cv, &Svga.mtx);
+			}
+		}
+		sync = Svga.syncreq;
+		Svga.syncreq = FALSE;
+		if (!Svga.reg[regCONFIG] || !Svga.reg[regENABLE]) {
+			if (sync) Svga.busy = FALSE;
+			continue;
+		}
+		pthread_mutex_unlock(&Svga.mtx);
+
+		/* idle again, doorbell is rung for the next command */
+		fence = FALSE;
+		do {
+			if (processFIFO()) fence = TRUE;
+			Svga.fifo[fifoBUSY] = 0;
+			__sync_synchronize();
+		} while (Svga.fifo[fifoNEXT] != Svga.fifo[fifoSTOP] &&
+			 Svga.cnt.error == 0);
+		spend(COST_SLEEP);	/* pay what is owed */
+
+		pthread_mutex_lock(&Svga.mtx);
+		if (sync && !Svga.syncreq) Svga.busy = FALSE;
+		irq = (fence && (Svga.reg[regIRQMASK] & irqANY_FENCE));
+		if (irq) {
+			Svga.irqstatus |= irqANY_FENCE;
+			Svga.cnt.irq++;
+		}
+
+		/* handler accesses ports, device lock is not held */
+		if (irq) {
+			pthread_mutex_unlock(&Svga.mtx);
+			hostRaiseInt(IV_IRQ(IRQ));
+			pthread_mutex_lock(&Svga.mtx);
+		}
+	}
+	pthread_mutex_unlock(&Svga.mtx);
+
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------ */
+/*
+	set up the device (PCI, memory, ports) and start consumer
+*/
+EXPORT	void	svgaStart(SvgaConf *conf)
+{
+	UW	bar[3];
+	pthread_condattr_t	ca;
+
+	memset(&Svga, 0, sizeof(Svga));
+	Svga.conf = *conf;
+	pthread_mutex_init(&Svga.mtx, NULL);
+	pthread_condattr_init(&ca);
+	pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+	pthread_cond_init(&Svga.cv, &ca);
+
+	if (posix_memalign((void **)&Svga.vram, 4096, FB_SIZE) != 0 ||
+	    posix_memalign((void **)&Svga.fifo, 4096, FIFO_SIZE) != 0) {
+		fprintf(stderr, "svga: no memory\n");
+		exit(1);
+	}
+	memset(Svga.vram, 0, FB_SIZE);
+	memset((void *)Svga.fifo, 0, FIFO_SIZE);
+	Svga.fifo[fifoCAP] = conf->fence ? fifoCAP_FENCE : 0;
+
+	Svga.reg[regID] = regID_MAGIC(0);
+	Svga.reg[regMAX_WIDTH] = MAX_WIDTH;
+	Svga.reg[regMAX_HEIGHT] = MAX_HEIGHT;
+	Svga.reg[regVRAMSIZE] = FB_SIZE;
+	Svga.reg[regCAP] = conf->cap;
+	Svga.reg[regFIFOSIZE] = FIFO_SIZE;
+	Svga.reg[regWIDTH] = 1024;
+	Svga.reg[regHEIGHT] = 768;
+	Svga.reg[regBPP] = 32;
+
+	hostAddRegion(FB_PADDR, FB_SIZE, Svga.vram);
+	hostAddRegion(FIFO_PADDR, FIFO_SIZE, (void *)Svga.fifo);
+
+	Svga.io.base = IOBASE;
+	Svga.io.size = 16;
+	Svga.io.in = svgaIn;
+	Svga.io.out = svgaOut;
+	hostAddIO(&Svga.io);
+
+	bar[0] = IOBASE | 1;
+	bar[1] = FB_PADDR | 0x08;	/* prefetchable */
+	bar[2] = FIFO_PADDR;
+	hostAddPci(0x15ad, 0x0405, bar, IRQ);
+
+	Svga.run = TRUE;
+	pthread_create(&Svga.th, NULL, svgaTask, NULL);
+	return;
+}
+
+EXPORT	void	svgaStop(void)
+{
+	pthread_mutex_lock(&Svga.mtx);
+	Svga.run = FALSE;
+	pthread_cond_signal(&Svga.cv);
+	pthread_mutex_unlock(&Svga.mtx);
+	pthread_join(Svga.th, NULL);
+	return;
+}
+
+EXPORT	void	svgaCount(SvgaCount *cnt)
+{
+	pthread_mutex_lock(&Svga.mtx);
+	*cnt = Svga.cnt;
+	pthread_mutex_unlock(&Svga.mtx);
+	return;
+}
+
+/* called for each command processed, from the consumer thread */
+EXPORT	void	svgaHook(void (*fn)(UW *cmd, W len))
+{
+	Svga.hook = fn;
+	return;
+}
+
+EXPORT	UB	*svgaVRAM(W *pitch)
+{
+	if (pitch != NULL) *pitch = readReg(regPITCH);
+	return Svga.vram;
+}
@@ -0,0 +1,1146 @@
+/*
+	test.c		host harness
+	damage tracking, format conversion, SVGA FIFO ring, requests,
+	Bochs BGA, None
+
+		* each case runs in its own process (hostRun), driver
+		  state starts from scratch
+		* driver is started by main() as the system does, the
+		  screen is 1024x768 in the color format of the build
+
+	Copyright 2026 by agent
+	This software is distributed under the T-License 2.0.
+*/
+#include "screen.h"
+#include "videomode.h"
+#include <stdlib.h>
+#include <unistd.h>
+#include "host.h"
+
+#define	WIDTH		1024
+#define	HEIGHT		768
+#define	NTHREAD		4
+
+#define	regCAP_RECT_FILL	(1 << 0)
+#define	regCAP_RECT_COPY	(1 << 1)
+#define	regCAP_RASTER_OP	(1 << 4)
+#define	regCAP_CURSOR_BYPASS_2	(1 << 7)
+#define	regCAP_ALPHA_CURSOR	(1 << 9)
+#define	regCAP_EXTFIFO	(1 << 15)
+#define	regCAP_IRQMASK	(1 << 18)
+
+#define	CAP_2D		(regCAP_RECT_FILL | regCAP_RECT_COPY | regCAP_RASTER_OP)
+
+#define	CHECK(exp)	do { if (!(exp)) { \
+				printf("\t%s:%d: %s\n", __FILE__, __LINE__, #exp); \
+				return FALSE; } } while (0)
+
+/* pixels updated by the device (fifoCMD_UPDATE), and expected ones */
+LOCAL	UB	Cover[HEIGHT][WIDTH];
+LOCAL	UB	Want[HEIGHT][WIDTH];
+
+/* update commands seen, and the last fill */
+#define	MAX_UPD		4096
+LOCAL	RECT	Upd[MAX_UPD];
+LOCAL	volatile W	NumUpd;
+LOCAL	UW	Fill[6];
+LOCAL	volatile W	NumFill;
+
+LOCAL	void	recordUpdate(UW *cmd, W len)
+{
+	W	y;
+	RECT	*r;
+
+	if (cmd[0] == 2) {		/* fifoCMD_RECT_FILL */
+		memcpy(Fill, cmd, sizeof(Fill));
+		NumFill++;
+	}
+	if (cmd[0] != 1) return;	/* fifoCMD_UPDATE */
+
+	for (y = cmd[2]; y < cmd[2] + cmd[4]; y++)
+		memset(&Cover[y][cmd[1]], 1, cmd[3]);
+
+	if (NumUpd < MAX_UPD) {
+		r = &Upd[NumUpd];
+		r->c.left = cmd[1];
+		r->c.top = cmd[2];
+		r->c.right = cmd[1] + cmd[3];
+		r->c.bottom = cmd[2] + cmd[4];
+		NumUpd++;
+	}
+	return;
+}
+
+LOCAL	void	resetRecord(void)
+{
+	memset(Cover, 0, sizeof(Cover));
+	memset(Want, 0, sizeof(Want));
+	NumUpd = NumFill = 0;
+	return;
+}
+
+/* request through the driver port */
+LOCAL	ERR	req(W cmd, W datano, void *buf, W size)
+{
+	return hostDevReq(cmd, datano, buf, size, NULL);
+}
+
+/* start device and driver, the screen is 1024x768 */
+LOCAL	BOOL	startScreen(SvgaConf *conf)
+{
+	hostSetConf("VIDEOMODE", 1, 4);
+	svgaStart(conf);
+	svgaHook(recordUpdate);
+	if (hostInitScreen() < ER_OK) return FALSE;
+	waitClear();		/* as requests do */
+
+	return (Vinf.width == WIDTH && Vinf.height == HEIGHT);
+}
+
+/* everything added has reached the device */
+LOCAL	void	settle(void)
+{
+	flushDamage();
+	(*Vinf.fn_sync)();
+	return;
+}
+
+/* first pixel wanted but not updated, FALSE if none */
+LOCAL	BOOL	missing(W *px, W *py)
+{
+	W	x, y;
+
+	for (y = 0; y < HEIGHT; y++) {
+		for (x = 0; x < WIDTH; x++) {
+			if (Want[y][x] && !Cover[y][x]) {
+				*px = x;
+				*py = y;
+				return TRUE;
+			}
+		}
+	}
+	return FALSE;
+}
+
+LOCAL	BOOL	covered(void)
+{
+	W	x, y;
+
+	if (missing(&x, &y)) {
+		printf("\t(%d, %d) is not updated\n", x, y);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/* wait for the flush task alone to update everything */
+LOCAL	BOOL	coveredIn(W msec)
+{
+	W	x, y;
+
+	for (; msec > 0 && missing(&x, &y); msec -= 10) usleep(10000);
+	return covered();
+}
+
+/* ------------------------------------------------------------------------ */
+/*
+	clients adding small rectangles at once
+*/
+typedef struct {
+	W	id;
+	W	count;		/* rectangles per thread */
+	W	size;		/* maximum width / height */
+	W	pause;		/* usec between rectangles */
+} AddArg;
+
+LOCAL	void	*addTask(void *arg)
+{
+	AddArg	*a = arg;
+	W	i, x, y, w, h, j;
+	unsigned int	seed = a->id * 7919 + 1;
+
+	for (i = 0; i < a->count; i++) {
+		w = rand_r(&seed) % a->size + 1;
+		h = rand_r(&seed) % a->size + 1;
+		x = rand_r(&seed) % (WIDTH - w);
+		y = rand_r(&seed) % (HEIGHT - h);
+
+		/* Want[] is written by every thread, same value */
+		for (j = y; j < y + h; j++) memset(&Want[j][x], 1, w);
+		(*Vinf.fn_updscr)(x, y, w, h);
+
+		if (a->pause > 0) usleep(a->pause);
+	}
+	return NULL;
+}
+
+LOCAL	void	addConcurrent(W count, W size, W pause)
+{
+	W	i;
+	pthread_t	th[NTHREAD];
+	AddArg	arg[NTHREAD];
+
+	for (i = 0; i < NTHREAD; i++) {
+		arg[i].id = i;
+		arg[i].count = count;
+		arg[i].size = size;
+		arg[i].pause = pause;
+		pthread_create(&th[i], NULL, addTask, &arg[i]);
+	}
+	for (i = 0; i < NTHREAD; i++) pthread_join(th[i], NULL);
+	return;
+}
+
+/* ------------------------------------------------------------------------ */
+
+/* merged rectangles cover every update, with fewer commands */
+LOCAL	BOOL	testDamageRect(void)
+{
+	SvgaCount	cnt;
+	SvgaConf	conf = {.cap = CAP_2D, .refresh = 16};
+
+	CHECK(startScreen(&conf));
+	settle();
+	resetRecord();
+
+	addConcurrent(500, 64, 10);
+	settle();
+	svgaCount(&cnt);
+
+	CHECK(covered());
+	CHECK(NumUpd > 0 && NumUpd < NTHREAD * 500);
+	CHECK(cnt.error == 0);
+
+	hostFinishScreen();
+	return TRUE;
+}
+
+/* paced (VIDEOVFREQ): tiles cover every update, aligned to tiles */
+LOCAL	BOOL	testDamageTile(void)
+{
+	W	i;
+	SvgaCount	cnt;
+	SvgaConf	conf = {.cap = CAP_2D, .refresh = 16};
+
+	hostSetConf("VIDEOVFREQ", 1, 60);
+	CHECK(startScreen(&conf));
+	settle();
+	resetRecord();
+
+	addConcurrent(300, 48, 20);
+	settle();
+	svgaCount(&cnt);
+
+	CHECK(covered());
+	CHECK(cnt.error == 0);
+
+	/* tile is 64x16 at 1024x768 */
+	for (i = 0; i < NumUpd; i++) {
+		CHECK(Upd[i].c.left % 64 == 0 && Upd[i].c.top % 16 == 0);
+		CHECK(Upd[i].c.right % 64 == 0 || Upd[i].c.right == WIDTH);
+		CHECK(Upd[i].c.bottom % 16 == 0 || Upd[i].c.bottom == HEIGHT);
+	}
+
+	hostFinishScreen();
+	return TRUE;
+}
+
+/* lost rectangles (queue is full while held) update whole screen */
+LOCAL	BOOL	testDamageOverflow(void)
+{
+	W	i;
+	BOOL	full;
+	SvgaConf	conf = {.cap = CAP_2D, .refresh = 16};
+
+	CHECK(startScreen(&conf));
+	settle();
+	resetRecord();
+
+	holdDamage();
+	for (i = 0; i < 1000; i++) {
+		(*Vinf.fn_updscr)((i * 37) % (WIDTH - 8),
+				  (i * 16) % (HEIGHT - 8), 8, 8);
+	}
+	CHECK(NumUpd == 0);		/* backend is idle while held */
+	releaseDamage();
+	settle();
+
+	for (i = 0, full = FALSE; i < NumUpd; i++) {
+		if (Upd[i].c.left == 0 && Upd[i].c.top == 0 &&
+		    Upd[i].c.right == WIDTH && Upd[i].c.bottom == HEIGHT)
+			full = TRUE;
+	}
+	CHECK(full);
+
+	hostFinishScreen();
+	return TRUE;
+}
+
+/* capture takes changed tiles, clears only those inside its rectangle */
+LOCAL	BOOL	testTakeChanged(void)
+{
+	W	tw, th;
+	UW	tile[DMG_TILEROW];
+	RECT	all = {{0, 0, WIDTH, HEIGHT}};
+	RECT	left = {{0, 0, 128, HEIGHT}};
+	SvgaConf	conf = {.cap = CAP_2D, .refresh = 16};
+
+	CHECK(startScreen(&conf));
+	settle();
+	CHECK(takeChanged(&all, tile, &tw, &th));
+	CHECK(tw == 64 && th == 16);
+	CHECK(takeChanged(&all, tile, &tw, &th));
+	CHECK(tile[0] == 0 && tile[47] == 0);
+
+	/* tiles #1-4 of rows #6-12 */
+	(*Vinf.fn_updscr)(100, 100, 200, 100);
+	CHECK(takeChanged(&left, tile, &tw, &th));
+	CHECK(tile[5] == 0 && tile[6] == 0x1e && tile[12] == 0x1e &&
+	      tile[13] == 0);
+
+	/* columns #0-1 were inside, #2-4 are still changed */
+	CHECK(takeChanged(&all, tile, &tw, &th));
+	CHECK(tile[6] == 0x1c && tile[12] == 0x1c);
+	CHECK(takeChanged(&all, tile, &tw, &th));
+	CHECK(tile[6] == 0);
+
+	hostFinishScreen();
+	return TRUE;
+}
+
+/* ------------------------------------------------------------------------ */
+/*
+	format conversion (convert.c), virtual VRAM to FrameBuffer
+*/
+#define	CW	67		/* odd width, SIMD tail is used */
+#define	CH	9
+
+LOCAL	CONST	UB	Bayer[4][4] = {
+	{ 0,  8,  2, 10},
+	{12,  4, 14,  6},
+	{ 3, 11,  1,  9},
+	{15,  7, 13,  5},
+};
+
+LOCAL	UW	ref565to32(UW p)
+{
+	UW	r = (p >> 11) & 0x1f, g = (p >> 5) & 0x3f, b = p & 0x1f;
+
+	return (((r << 3) | (r >> 2)) << 16) | (((g << 2) | (g >> 4)) << 8) |
+		((b << 3) | (b >> 2));
+}
+
+LOCAL	UW	sat(UW v)
+{
+	return (v > 255) ? 255 : v;
+}
+
+LOCAL	UH	ref32to565(UW p, W x, W y, BOOL dither)
+{
+	UW	t, r, g, b;
+
+	t = dither ? Bayer[y & 3][x & 3] : 0;
+	r = sat(((p >> 16) & 0xff) + (t >> 1));
+	g = sat(((p >> 8) & 0xff) + (t >> 2));
+	b = sat((p & 0xff) + (t >> 1));
+	return ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+}
+
+/* set up Vinf for src -> dst (bits), FALSE if not converted */
+LOCAL	BOOL	setupConvert(W src, W dst, BOOL dither, BOOL simd)
+{
+	W	i;
+	LOCAL	COLOR	cmap[256];
+
+	memset(&Vinf, 0, sizeof(Vinf));
+	Vinf.width = CW;
+	Vinf.height = CH;
+	Vinf.pixbits = (src == 8) ? 0x0808 : (src == 16) ? 0x1010 : 0x2018;
+	Vinf.pixbyte = src / 8;
+	Vinf.rowbytes = CW * Vinf.pixbyte + 12;		/* padded */
+	Vinf.framebuf_rowb = CW * (dst / 8) + 20;
+	Vinf.v_addr = calloc(CH, Vinf.rowbytes);
+	Vinf.f_addr = calloc(CH, Vinf.framebuf_rowb);
+	Vinf.baseaddr = Vinf.v_addr;
+
+	CpuSIMD = simd ? SIMD_SSE2 : SIMD_NONE;
+	hostSetConf("VIDEOSCANOUT", 2, dst, dither);
+	if (initConvert(Vinf.pixbits) < ER_OK || !Vinf.scanbits)
+		return FALSE;
+
+	if (src == 8) {
+		for (i = 0; i < 256; i++) cmap[i] = (i * 0x9e3779b1) >> 8;
+		Vinf.cmap = cmap;
+		convSetCmap(cmap, 0, 256);
+	}
+	return TRUE;
+}
+
+/* convert pixels p[] placed in virtual VRAM, sub-rectangle r */
+LOCAL	void	runConvert(UW *p, RECT *r)
+{
+	W	x, y;
+	UB	*s;
+
+	for (y = 0; y < CH; y++) {
+		s = Vinf.v_addr + y * Vinf.rowbytes;
+		for (x = 0; x < CW; x++)
+			memcpy(s + x * Vinf.pixbyte, &p[y * CW + x], Vinf.pixbyte);
+	}
+	convRect(r, 1);
+	return;
+}
+
+LOCAL	UW	scanPixel(W x, W y)
+{
+	UB	*d = Vinf.f_addr + y * Vinf.framebuf_rowb;
+
+	return (ScanByte == 2) ? ((UH *)d)[x] : ((UW *)d)[x];
+}
+
+LOCAL	BOOL	checkConvert(W src, W dst, BOOL dither, BOOL simd)
+{
+	W	x, y, i;
+	UW	p[CW * CH], want;
+	RECT	r = {{3, 1, CW, CH - 1}};	/* odd start for dithering */
+	unsigned int	seed = 12345;
+
+	CHECK(setupConvert(src, dst, dither, simd));
+	initCursor();
+
+	/* 16bpp source covers all values over the runs */
+	for (i = 0; i < CW * CH; i++) p[i] = rand_r(&seed) * 2654435761U;
+	runConvert(p, &r);
+
+	for (y = 0; y < CH; y++) {
+		for (x = 0; x < CW; x++) {
+			if (x < r.c.left || y < r.c.top || y >= r.c.bottom) {
+				CHECK(scanPixel(x, y) == 0);
+				continue;
+			}
+			i = y * CW + x;
+			if (src == 8) {
+				want = Vinf.cmap[p[i] & 0xff] & 0xffffff;
+				if (dst == 16) want = ref32to565(want, 0, 0, 0);
+			} else if (src == 16) {
+				want = ref565to32(p[i] & 0xffff);
+			} else {
+				want = ref32to565(p[i], x, y, dither);
+			}
+			if (scanPixel(x, y) != want) {
+				printf("\t%d -> %d%s%s (%d, %d): %08x != %08x\n",
+				       src, dst, dither ? " dither" : "",
+				       simd ? " SIMD" : "", x, y,
+				       scanPixel(x, y), want);
+				return FALSE;
+			}
+		}
+	}
+
+	free(Vinf.v_addr);
+	free(Vinf.f_addr);
+	return TRUE;
+}
+
+LOCAL	BOOL	testConvert(void)
+{
+	W	simd;
+
+	for (simd = 0; simd < 2; simd++) {
+		CHECK(checkConvert(16, 32, FALSE, simd));
+		CHECK(checkConvert(32, 16, FALSE, simd));
+		CHECK(checkConvert(32, 16, TRUE, simd));
+		CHECK(checkConvert(8, 32, FALSE, simd));
+		CHECK(checkConvert(8, 16, FALSE, simd));
+	}
+	return TRUE;
+}
+
+/* 16bpp -> 32bpp covers every 565 value */
+LOCAL	BOOL	testConvert565(void)
+{
+	W	i, simd;
+	UW	s[0x10000 / 2];
+	UW	d[0x10000];
+	UW	c[0x10000];
+
+	for (i = 0; i < 0x10000; i += 2) s[i / 2] = i | ((UW)(i + 1) << 16);
+
+	for (simd = 0; simd < 2; simd++) {
+		CpuSIMD = simd ? SIMD_SSE2 : SIMD_NONE;
+		expandRow((UB *)d, (UB *)s, 0x10000, 2);
+		for (i = 0; i < 0x10000; i++) c[i] = ref565to32(i);
+		CHECK(memcmp(c, d, sizeof(d)) == 0);
+	}
+	return TRUE;
+}
+
+/* VIDEOSCANOUT: flush converts what was damaged, then updates it */
+LOCAL	BOOL	testScanout(void)
+{
+	W	x, y, dst;
+	UW	p, want;
+	UB	*s, *d;
+	SvgaConf	conf = {.cap = CAP_2D, .refresh = 16};
+
+	dst = (VideoFmt->pixbits == 0x2018) ? 16 : 32;
+	hostSetConf("VIDEOSCANOUT", 2, dst, 0);
+	CHECK(startScreen(&conf));
+	CHECK(Vinf.scanbits != 0 && Vinf.v_addr != Vinf.f_addr);
+	settle();
+	resetRecord();
+
+	for (y = 100; y < 140; y++) {
+		s = Vinf.v_addr + y * Vinf.rowbytes;
+		for (x = 200; x < 260; x++) {
+			p = (x * 0x010203 + y * 0x030201) & 0x00ffffff;
+			memcpy(s + x * Vinf.pixbyte, &p, Vinf.pixbyte);
+		}
+		memset(&Want[y][200], 1, 60);
+	}
+	(*Vinf.fn_updscr)(200, 100, 60, 40);
+	settle();
+	CHECK(covered());
+
+	for (y = 100; y < 140; y++) {
+		s = Vinf.v_addr + y * Vinf.rowbytes;
+		d = Vinf.f_addr + y * Vinf.framebuf_rowb;
+		for (x = 200; x < 260; x++) {
+			p = 0;
+			memcpy(&p, s + x * Vinf.pixbyte, Vinf.pixbyte);
+			if (Vinf.pixbyte == 1) {
+				want = Vinf.cmap[p] & 0xffffff;
+				if (dst == 16) want = ref32to565(want, 0, 0, 0);
+			} else if (Vinf.pixbyte == 2) {
+				want = ref565to32(p);
+			} else {
+				want = ref32to565(p, 0, 0, 0);
+			}
+			p = (dst == 16) ? ((UH *)d)[x] : ((UW *)d)[x];
+			CHECK(p == want);
+		}
+	}
+
+	hostFinishScreen();
+	return TRUE;
+}
+
+/* ------------------------------------------------------------------------ */
+/*
+	FIFO ring (vmsvga.c)
+*/
+
+/* tiny ring and slow host: ring wraps, driver waits, nothing is lost */
+LOCAL	BOOL	testFifoRing(void)
+{
+	SvgaCount	cnt;
+	SvgaConf	conf = {.cap = CAP_2D, .refresh = 16,
+			.cmdcost = 20000, .pixcost = 50};
+
+	hostSetConf("VMSVGACMDENTRY", 1, 4);
+	hostSetConf("VIDEODAMAGE", 3, 100, 0, 0);
+	CHECK(startScreen(&conf));
+	settle();
+	resetRecord();
+
+	addConcurrent(400, 16, 100);
+	settle();
+	svgaCount(&cnt);
+
+	CHECK(covered());
+	CHECK(cnt.error == 0);
+	CHECK(cnt.update > 4 * 4);	/* ring of 4 went round */
+
+	hostFinishScreen();
+	return TRUE;
+}
+
+/* interrupt driven flow control: fences, no busy wait for space */
+LOCAL	BOOL	testFifoIrq(void)
+{
+	UW	fence;
+	SvgaCount	cnt;
+	SvgaConf	conf = {.cap = CAP_2D | regCAP_IRQMASK | regCAP_EXTFIFO,
+			.fence = TRUE, .refresh = 16,
+			.cmdcost = 20000, .pixcost = 50};
+
+	hostSetConf("VMSVGACMDENTRY", 1, 8);
+	hostSetConf("VMSVGAIRQ", 2, 1, 50);
+	hostSetConf("VIDEODAMAGE", 3, 100, 0, 0);
+	CHECK(startScreen(&conf));
+	settle();
+	resetRecord();
+
+	addConcurrent(400, 16, 0);
+	settle();
+	svgaCount(&cnt);
+
+	CHECK(covered());
+	CHECK(cnt.error == 0);
+	CHECK(cnt.fence > 0 && cnt.irq > 0);
+
+	/* client fence */
+	(*Vinf.fn_updscr)(0, 0, 64, 64);
+	flushDamage();
+	fence = (*Vinf.fn_fence)();
+	CHECK(fence != 0);
+	CHECK((*Vinf.fn_fencewait)(fence, -1) == ER_OK);
+	CHECK((*Vinf.fn_fencewait)(fence, 0) == ER_OK);
+
+	hostFinishScreen();
+	return TRUE;
+}
+
+/* damage added during a fence wait of the flush task wakes it up */
+LOCAL	BOOL	testFenceWakeup(void)
+{
+	W	i;
+	SvgaCount	cnt;
+	SvgaConf	conf = {.cap = CAP_2D | regCAP_IRQMASK | regCAP_EXTFIFO,
+			.fence = TRUE, .refresh = 16,
+			.cmdcost = 20000, .pixcost = 50};
+
+	hostSetConf("VMSVGACMDENTRY", 1, 4);
+	hostSetConf("VMSVGAIRQ", 2, 1, 50);
+	hostSetConf("VIDEODAMAGE", 3, 100, 0, 0);
+	CHECK(startScreen(&conf));
+	settle();
+	resetRecord();
+
+	/* no flushDamage(), updates are left to the flush task */
+	for (i = 0; i < 20; i++) {
+		addConcurrent(20, 16, 50);
+		CHECK(coveredIn(1000));
+	}
+	svgaCount(&cnt);
+	CHECK(cnt.error == 0 && cnt.fence > 0);
+
+	hostFinishScreen();
+	return TRUE;
+}
+
+/* ------------------------------------------------------------------------ */
+/*
+	2D commands (DN_SCRWRITE): device draws what the driver asked
+*/
+LOCAL	UW	vramPixel(W x, W y)
+{
+	UW	p = 0;
+
+	memcpy(&p, (UB *)Vinf.f_addr + y * Vinf.framebuf_rowb +
+	       x * Vinf.pixbyte, Vinf.pixbyte);
+	return p;
+}
+
+LOCAL	BOOL	testWrite(void)
+{
+	W	x, y;
+	UW	mask, a, b;
+	ScrWrFill	fill;
+	ScrWrCopy	copy;
+	SvgaConf	conf = {.cap = CAP_2D, .refresh = 16};
+
+	CHECK(startScreen(&conf));
+	if (Vinf.scanbits) return TRUE;		/* not available */
+
+	mask = (Vinf.pixbyte == 4) ? ~0U : (1U << (Vinf.pixbyte * 8)) - 1;
+	a = 0x00ff00ff & mask;
+	b = 0x0f0f330f & mask;
+
+	/* fill is clipped to the screen */
+	fill.kind = SCRWR_FILL;
+	fill.r.c.left = -10;
+	fill.r.c.top = 0;
+	fill.r.c.right = 100;
+	fill.r.c.bottom = 50;
+	fill.pixel = a;
+	CHECK((*Vinf.fn_write)(SCRWR_FILL, &fill, sizeof(fill)) == ER_OK);
+	fill.r.c.left = 200;
+	fill.r.c.right = 300;
+	fill.pixel = b;
+	CHECK((*Vinf.fn_write)(SCRWR_FILL, &fill, sizeof(fill)) == ER_OK);
+	CHECK(vramPixel(0, 0) == a && vramPixel(99, 49) == a);
+	CHECK(vramPixel(100, 0) == ((Vinf.cmapent > 0) ? 0xFF : 0));
+	CHECK(vramPixel(250, 10) == b);
+
+	/* XOR copy */
+	copy.kind = SCRWR_ROPCOPY;
+	copy.r.c.left = 200;
+	copy.r.c.top = 0;
+	copy.r.c.right = 260;
+	copy.r.c.bottom = 50;
+	copy.sp.x = 0;
+	copy.sp.y = 0;
+	copy.rop = SCRROP_XOR;
+	CHECK((*Vinf.fn_write)(SCRWR_ROPCOPY, &copy, sizeof(copy)) == ER_OK);
+	CHECK(vramPixel(200, 0) == (a ^ b) && vramPixel(259, 49) == (a ^ b));
+	CHECK(vramPixel(260, 0) == b);
+
+	/* overlapping copy, one pixel to the right and down */
+	for (y = 0; y < 50; y++) {
+		for (x = 0; x < 100; x++) {
+			memcpy((UB *)Vinf.f_addr + y * Vinf.framebuf_rowb +
+			       x * Vinf.pixbyte, &(UW){(x + y * 3) & mask},
+			       Vinf.pixbyte);
+		}
+	}
+	copy.kind = SCRWR_COPY;
+	copy.r.c.left = 1;
+	copy.r.c.top = 1;
+	copy.r.c.right = 100;
+	copy.r.c.bottom = 50;
+	CHECK((*Vinf.fn_write)(SCRWR_COPY, &copy, sizeof(copy)) == ER_OK);
+	for (y = 1; y < 50; y++) {
+		for (x = 1; x < 100; x++) {
+			CHECK(vramPixel(x, y) == ((x - 1 + (y - 1) * 3) & mask));
+		}
+	}
+
+	hostFinishScreen();
+	return TRUE;
+}
+
+/* cursor image larger than a small ring does not stall the driver */
+LOCAL	BOOL	testCursorRing(void)
+{
+	W	i;
+	ERR	err;
+	LOCAL	UW	buf[(sizeof(ScrCurShape) / sizeof(UW)) +
+			    CURSOR_MAX * CURSOR_MAX];
+	ScrCurShape	*shape = (ScrCurShape *)buf;
+	SvgaConf	conf = {.cap = CAP_2D | regCAP_ALPHA_CURSOR |
+			regCAP_CURSOR_BYPASS_2, .refresh = 16};
+
+	hostSetConf("VMSVGACMDENTRY", 1, 16);
+	CHECK(startScreen(&conf));
+
+	shape->kind = SCRCUR_SHAPE;
+	shape->w = shape->h = CURSOR_MAX;
+	shape->hotx = shape->hoty = 0;
+	for (i = 0; i < CURSOR_MAX * CURSOR_MAX; i++)
+		((UW *)(shape + 1))[i] = 0xff000000;
+
+	err = setSCRCURSOR(SCRCUR_SHAPE, buf, sizeof(buf));
+	CHECK(err == ER_OK || err == ER_NOSPT);
+
+	hostFinishScreen();
+	return TRUE;
+}
+
+/* ------------------------------------------------------------------------ */
+/*
+	requests through the port (main.c), common.c
+*/
+LOCAL	BOOL	testRequest(void)
+{
+	W	y, n, no, mode;
+	DEV_SPEC	spec;
+	BMP	bmp;
+	RECT	r = {{100, 200, 164, 232}};
+	SvgaConf	conf = {.cap = CAP_2D, .refresh = 16};
+
+	CHECK(startScreen(&conf));
+	settle();
+	resetRecord();
+
+	CHECK(hostDevReq(DC_READ, DN_SCRSPEC, &spec, sizeof(spec), &n) ==
+	      ER_OK);
+	CHECK(n == sizeof(spec) && spec.pixbits == Vinf.pixbits);
+	CHECK(spec.hpixels == WIDTH && spec.vpixels == HEIGHT);
+	CHECK(req(DC_READ, DN_SCRNO, &no, sizeof(no)) == ER_OK && no == 4);
+	CHECK(req(DC_READ, DN_SCRBMP, &bmp, sizeof(bmp)) == ER_OK);
+	CHECK(bmp.baseaddr[0] == Vinf.baseaddr);
+
+	/* queued update is emitted and waited for by DN_SCRFLUSH */
+	for (y = 200; y < 232; y++) memset(&Want[y][100], 1, 64);
+	CHECK(req(DC_WRITE, DN_SCRUPDRECT, &r, sizeof(r)) == ER_OK);
+	mode = FLUSH_WAIT;
+	CHECK(req(DC_WRITE, DN_SCRFLUSH, &mode, sizeof(mode)) == ER_OK);
+	CHECK(covered());
+
+	/* wrong direction, short buffer, unknown data number */
+	CHECK(req(DC_WRITE, DN_SCRSPEC, &spec, sizeof(spec)) == ER_PAR);
+	CHECK(req(DC_READ, DN_SCRSPEC, &spec, 4) == ER_PAR);
+	CHECK(req(DC_READ, -999, &spec, sizeof(spec)) == ER_PAR);
+
+	hostFinishScreen();
+	return TRUE;
+}
+
+/* DN_SCRNO: size changes, cached state follows */
+LOCAL	BOOL	testModeChange(void)
+{
+	W	no, pitch;
+	DEV_SPEC	spec;
+	BMP	bmp;
+	SvgaConf	conf = {.cap = CAP_2D, .refresh = 16};
+
+	CHECK(startScreen(&conf));
+
+	no = 2;					/* 640x480 */
+	CHECK(req(DC_WRITE, DN_SCRNO, &no, sizeof(no)) == ER_OK);
+	CHECK(req(DC_READ, DN_SCRNO, &no, sizeof(no)) == ER_OK && no == 2);
+	CHECK(req(DC_READ, DN_SCRSPEC, &spec, sizeof(spec)) == ER_OK);
+	CHECK(spec.hpixels == 640 && spec.vpixels == 480);
+	CHECK(req(DC_READ, DN_SCRBMP, &bmp, sizeof(bmp)) == ER_OK);
+	CHECK(bmp.bounds.c.right == 640 && bmp.bounds.c.bottom == 480);
+	svgaVRAM(&pitch);
+	CHECK(pitch == 640 * ScanByte);
+
+	no = MAX_VIDEO_MODE + 1;
+	CHECK(req(DC_WRITE, DN_SCRNO, &no, sizeof(no)) == ER_PAR);
+
+	hostFinishScreen();
+	return TRUE;
+}
+
+/* 8bpp on SVGA FIFO: screen is cleared by the device, then shown */
+LOCAL	BOOL	testInitialClear(void)
+{
+	W	y;
+	SvgaConf	conf = {.cap = CAP_2D, .refresh = 16};
+
+	hostSetConf("VIDEOMODE", 2, 4, 8);
+	svgaStart(&conf);
+	svgaHook(recordUpdate);
+	CHECK(hostInitScreen() >= ER_OK && Vinf.cmapent == 256);
+	settle();
+
+	CHECK(NumFill == 1 && Fill[1] == 0xFF);
+	CHECK(Fill[2] == 0 && Fill[3] == 0 &&
+	      Fill[4] == WIDTH && Fill[5] == HEIGHT);
+	for (y = 0; y < HEIGHT; y++) memset(Want[y], 1, WIDTH);
+	CHECK(covered());
+	CHECK(vramPixel(0, 0) == 0xFF && vramPixel(WIDTH - 1, HEIGHT - 1) == 0xFF);
+
+	hostFinishScreen();
+	return TRUE;
+}
+
+/* color map and spec of each mode are read whole while being changed */
+LOCAL	UW	CmapA[256], CmapB[256];
+
+LOCAL	void	*colorTask(void *arg)
+{
+	W	i;
+
+	for (i = 0; i < 300; i++) {
+		req(DC_WRITE, DN_SCRCOLOR, (i & 1) ? CmapB : CmapA,
+		    sizeof(CmapA));
+	}
+	return NULL;
+}
+
+LOCAL	BOOL	testColor(void)
+{
+	W	i;
+	UW	buf[256];
+	DEV_SPEC	spec;
+	pthread_t	th;
+	SvgaConf	conf = {.cap = CAP_2D, .refresh = 16};
+
+	hostSetConf("VIDEOMODE", 2, 4, 8);
+	svgaStart(&conf);
+	CHECK(hostInitScreen() >= ER_OK && Vinf.cmapent == 256);
+
+	CHECK(req(DC_READ, DN_SCRCOLOR, buf, sizeof(buf)) >= ER_OK);
+	CHECK(memcmp(buf, Vinf.cmap, sizeof(buf)) == 0);
+
+	for (i = 0; i < 256; i++) {
+		CmapA[i] = 0x10000000 | (i * 0x010101);
+		CmapB[i] = 0x10000000 | ((255 - i) * 0x010101);
+	}
+	CHECK(req(DC_WRITE, DN_SCRCOLOR, CmapA, sizeof(CmapA)) >= ER_OK);
+	pthread_create(&th, NULL, colorTask, NULL);
+	for (i = 0; i < 300; i++) {
+		CHECK(req(DC_READ, DN_SCRCOLOR, buf, sizeof(buf)) >= ER_OK);
+		CHECK(memcmp(buf, CmapA, sizeof(buf)) == 0 ||
+		      memcmp(buf, CmapB, sizeof(buf)) == 0);
+	}
+	pthread_join(th, NULL);
+
+	/* mode #3 is 1024x768 */
+	CHECK(req(DC_READ, DN_SCRXSPEC(4), &spec, sizeof(spec)) == ER_OK);
+	CHECK(spec.hpixels == WIDTH && spec.pixbits == 0x0808);
+	CHECK(req(DC_READ, DN_SCRXSPEC(MAX_VIDEO_MODE + 1), &spec,
+		  sizeof(spec)) == ER_NOSPT);
+
+	hostFinishScreen();
+	return TRUE;
+}
+
+/* FrameBuffer is made write-combining by MTRR, with caches disabled */
+LOCAL	BOOL	testWCombine(void)
+{
+	W	i, n;
+	HostCpu	cpu0, cpu;
+	ScrDevInfo	inf;
+	SvgaConf	conf = {.cap = CAP_2D, .refresh = 16};
+
+	hostCpu(&cpu0);
+	hostSetConf("VIDEOATTR", 1, 2);		/* USE_WCOMBINE */
+	CHECK(startScreen(&conf));
+	CHECK(Vinf.attr & USE_WCOMBINE);
+	hostCpu(&cpu);
+
+	/* #0 belongs to firmware, one free range is taken */
+	for (i = n = 0; i < 8; i++) {
+		if (cpu.physbase[i] == cpu0.physbase[i] &&
+		    cpu.physmask[i] == cpu0.physmask[i]) continue;
+		n++;
+		CHECK(i > 0 && cpu.physbase[i] == (0xe0000000 | 0x01));
+		CHECK((cpu.physmask[i] & 0xfffff800) == (0xff000000 | 0x800));
+	}
+	CHECK(n == 1);
+	CHECK(cpu.cached == 0 && cpu.cr0 == cpu0.cr0);
+	CHECK(cpu.wbinvd >= 2 && cpu.tlbflush >= 1);
+
+	CHECK(req(DC_READ, DN_SCRDEVINFO, &inf, sizeof(inf)) == ER_OK);
+	CHECK(strcmp((char *)inf.name2, "write-combining") == 0);
+
+	/* stores are drained before the device reads them */
+	(*Vinf.fn_updscr)(0, 0, 64, 64);
+	settle();
+	hostCpu(&cpu);
+	CHECK(cpu.drain > cpu0.drain);
+
+	hostFinishScreen();
+	return TRUE;
+}
+
+/* ------------------------------------------------------------------------ */
+/*
+	Bochs BGA (bga.c) on DISPI
+*/
+LOCAL	BOOL	startBga(W refresh)
+{
+	hostSetConf("VIDEOMODE", 1, 4);
+	dispiStart(refresh);
+	if (hostInitScreen() < ER_OK) return FALSE;
+
+	return (Vinf.width == WIDTH && Vinf.height == HEIGHT &&
+		strcmp((char *)Vinf.chipinf, "Bochs Graphics Adapter") == 0);
+}
+
+/* mode set, color map, initial clear, mode change, exit */
+LOCAL	BOOL	testBgaMode(void)
+{
+	W	no, i;
+	DEV_SPEC	spec;
+	DispiState	st;
+
+	CHECK(startBga(60));
+	dispiState(&st);
+	CHECK(st.xres == WIDTH && st.yres == HEIGHT);
+	CHECK(st.bpp == ((ScanBits >> 8) & 0xff));
+	CHECK(st.enable == 0x61 && st.modeset == 1);
+	CHECK(Vinf.flipbuf >= 2 && st.virtw == WIDTH &&
+	      st.virth == HEIGHT * Vinf.flipbuf);
+
+	/* a request waits for the initial clear */
+	CHECK(req(DC_READ, DN_SCRSPEC, &spec, sizeof(spec)) == ER_OK);
+	if (Vinf.cmapent > 0) {
+		dispiState(&st);
+		for (i = 0; i < 256; i++)
+			CHECK(st.palette[i] == (Vinf.cmap[i] & 0xffffff));
+		CHECK(dispiVRAM(0)[0] == 0xFF &&
+		      dispiVRAM(HEIGHT - 1)[WIDTH - 1] == 0xFF);
+	}
+
+	no = 2;					/* 640x480 */
+	CHECK(req(DC_WRITE, DN_SCRNO, &no, sizeof(no)) == ER_OK);
+	dispiState(&st);
+	CHECK(st.xres == 640 && st.yres == 480 && st.modeset == 2);
+	CHECK(req(DC_READ, DN_SCRSPEC, &spec, sizeof(spec)) == ER_OK);
+	CHECK(spec.hpixels == 640 && spec.vpixels == 480);
+
+	hostFinishScreen();
+	dispiState(&st);
+	CHECK(st.enable == 0);
+	return TRUE;
+}
+
+/*
+	page flip at vertical retrace
+		* input status is sampled once a msec, not busy polled
+		* wait ends within a frame time (MIN_VFREQ, VIDEOVFREQ is
+		  not set) even if the retrace does not come
+*/
+LOCAL	BOOL	checkFlip(W refresh)
+{
+	UD	t;
+	ScrFlipInf	inf;
+	ScrFlip	flip;
+	DispiState	st0, st;
+
+	CHECK(startBga(refresh));
+	CHECK(req(DC_READ, DN_SCRFLIP, &inf, sizeof(inf)) == ER_OK);
+	CHECK(inf.nbuf == Vinf.flipbuf && inf.front == 0 && inf.back == 1);
+
+	dispiState(&st0);
+	flip.buf = 1;
+	flip.mode = FLIP_VSYNC;
+	t = hostClock();
+	CHECK(req(DC_WRITE, DN_SCRFLIP, &flip, sizeof(flip)) == ER_OK);
+	t = hostClock() - t;
+	dispiState(&st);
+
+	CHECK(st.yofs == HEIGHT);
+	CHECK(st.statusrd - st0.statusrd <= 1000 / MIN_VFREQ + 2);
+	CHECK(t < 200000000);
+	if (refresh == 0) CHECK(t >= (1000 / MIN_VFREQ) * 1000000);
+
+	CHECK(req(DC_READ, DN_SCRFLIP, &inf, sizeof(inf)) == ER_OK);
+	CHECK(inf.front == 1 && inf.back != 1);
+
+	hostFinishScreen();
+	return TRUE;
+}
+
+LOCAL	BOOL	testBgaFlip(void)
+{
+	return checkFlip(60);
+}
+
+LOCAL	BOOL	testBgaFlipOff(void)
+{
+	return checkFlip(0);
+}
+
+/*
+	virtual VRAM (VIDEOATTR): drawing reaches FrameBuffer at flush
+		* virtual VRAM starts zero filled, also with color map
+*/
+LOCAL	BOOL	testBgaVVRAM(void)
+{
+	W	x, y, mode;
+	UW	p, mask;
+	ScrWrFill	fill;
+	ScrFlipInf	inf;
+
+	hostSetConf("VIDEOATTR", 1, 1);		/* USE_VVRAM */
+	CHECK(startBga(60));
+	CHECK(Vinf.v_addr != NULL && Vinf.v_addr != Vinf.f_addr);
+	CHECK(req(DC_READ, DN_SCRFLIP, &inf, sizeof(inf)) == ER_NOSPT);
+
+	mask = (Vinf.pixbyte == 4) ? ~0U : (1U << (Vinf.pixbyte * 8)) - 1;
+	fill.kind = SCRWR_FILL;
+	fill.r.c.left = 100;
+	fill.r.c.top = 50;
+	fill.r.c.right = 300;
+	fill.r.c.bottom = 90;
+	fill.pixel = 0x00a5c3e1 & mask;
+	CHECK(req(DC_WRITE, DN_SCRWRITE, &fill, sizeof(fill)) == ER_OK);
+	mode = FLUSH_EMIT;
+	CHECK(req(DC_WRITE, DN_SCRFLUSH, &mode, sizeof(mode)) == ER_OK);
+
+	for (y = 40; y < 100; y++) {
+		for (x = 90; x < 310; x += 7) {
+			p = 0;
+			memcpy(&p, dispiVRAM(y) + x * Vinf.pixbyte,
+			       Vinf.pixbyte);
+			CHECK(p == ((x >= 100 && x < 300 && y >= 50 && y < 90) ?
+				    fill.pixel : 0));
+		}
+	}
+
+	hostFinishScreen();
+	return TRUE;
+}
+
+/* ------------------------------------------------------------------------ */
+/*
+	None (none.c): no device, drawing goes to memory and the export ring
+*/
+LOCAL	BOOL	testNone(void)
+{
+	W	mode;
+	UW	h0;
+	ScrExportHdr	*hdr;
+	ScrExportRec	*r;
+	ScrWrFill	fill;
+	ScrDevInfo	inf;
+
+	hostSetConf("VIDEOMODE", 1, 4);
+	hostSetConf("VIDEOEXPORT", 1, 1);
+	CHECK(hostInitScreen() >= ER_OK);
+	CHECK(Vinf.width == WIDTH && Vinf.height == HEIGHT);
+	CHECK(req(DC_READ, DN_SCRDEVINFO, &inf, sizeof(inf)) == ER_OK);
+	CHECK(strcmp((char *)inf.name3, "None") == 0);
+
+	CHECK(req(DC_READ, DN_SCREXPORT, &hdr, sizeof(hdr)) == ER_OK);
+	CHECK(hdr->magic == CH4toW('v', 'm', 's', 'x'));
+
+	/* first frame drawn is a keyframe */
+	fill.kind = SCRWR_FILL;
+	fill.r.c.left = fill.r.c.top = 0;
+	fill.r.c.right = fill.r.c.bottom = 64;
+	fill.pixel = 0x12;
+	mode = FLUSH_EMIT;
+	CHECK(req(DC_WRITE, DN_SCRWRITE, &fill, sizeof(fill)) == ER_OK);
+	CHECK(req(DC_WRITE, DN_SCRFLUSH, &mode, sizeof(mode)) == ER_OK);
+	CHECK(*(UB *)Vinf.f_addr == 0x12);
+
+	r = (ScrExportRec *)(hdr + 1);
+	CHECK(hdr->head > 0);
+	CHECK(r->type == EXP_KEYFRAME && r->w == WIDTH && r->h == HEIGHT);
+
+	/* then changed tiles only */
+	h0 = hdr->head;
+	fill.pixel = 0x34;
+	CHECK(req(DC_WRITE, DN_SCRWRITE, &fill, sizeof(fill)) == ER_OK);
+	CHECK(req(DC_WRITE, DN_SCRFLUSH, &mode, sizeof(mode)) == ER_OK);
+
+	r = (ScrExportRec *)((UB *)(hdr + 1) + (h0 & (hdr->size - 1)));
+	CHECK(r->type == EXP_FRAME);
+	r = (ScrExportRec *)((UB *)(r + 1) + r->len);
+	CHECK(r->type == EXP_RLE && r->x == 0 && r->y == 0);
+	CHECK(hdr->head - h0 < 64 * 1024);
+
+	hostFinishScreen();
+	return TRUE;
+}
+
+/* ------------------------------------------------------------------------ */
+
+LOCAL	CONST	struct {
+	CONST B	*name;
+	BOOL	(*fn)(void);
+} Test[] = {
+	{"damage: merged rectangles cover updates", testDamageRect},
+	{"damage: paced tiles cover updates", testDamageTile},
+	{"damage: queue overflow updates whole screen", testDamageOverflow},
+	{"damage: capture clears tiles inside only", testTakeChanged},
+	{"convert: rows match reference, C and SSE2", testConvert},
+	{"convert: every RGB565 value", testConvert565},
+	{"convert: damaged region is converted at flush", testScanout},
+	{"vmsvga: small FIFO ring, slow host", testFifoRing},
+	{"vmsvga: interrupt and fence flow control", testFifoIrq},
+	{"vmsvga: damage during fence wait is flushed", testFenceWakeup},
+	{"vmsvga: fill, ROP copy, overlapping copy", testWrite},
+	{"vmsvga: cursor larger than FIFO ring", testCursorRing},
+	{"main: requests through the port", testRequest},
+	{"common: mode change (DN_SCRNO)", testModeChange},
+	{"common: initial clear by device fill (8bpp, FIFO)", testInitialClear},
+	{"common: color map and mode spec read whole", testColor},
+	{"common: write-combining MTRR, caches disabled", testWCombine},
+	{"bga: mode set, color map, mode change", testBgaMode},
+	{"bga: page flip at vertical retrace", testBgaFlip},
+	{"bga: page flip, display off, bounded wait", testBgaFlipOff},
+	{"bga: virtual VRAM flushed to FrameBuffer", testBgaVVRAM},
+	{"none: drawing and frame export", testNone},
+};
+
+int	main(int ac, char *av[])
+{
+	W	i, ng;
+
+	for (i = ng = 0; i < sizeof(Test) / sizeof(Test[0]); i++) {
+		if (ac > 1 && strstr((char *)Test[i].name, av[1]) == NULL)
+			continue;
+		if (!hostRun(Test[i].name, Test[i].fn)) ng++;
+	}
+	printf("%d failed\n", ng);
+
+	return ng ? 1 : 0;
+}
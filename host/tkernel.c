@@ -0,0 +1,1105 @@
+/*
+	tkernel.c	host harness
+	T-Kernel / device driver services on POSIX threads
+
+	Copyright 2026 by agent
+	This software is distributed under the T-License 2.0.
+*/
+#include <driver/driver.h>
+#include <driver/pcat/sys.h>
+#include <driver/pcat/pci.h>
+#include <btron/memory.h>
+#include <tcode.h>
+#include <tstring.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "host.h"
+
+#define	MAX_TASK	32
+#define	MAX_CYC		8
+#define	MAX_FLG		8
+#define	MAX_POR		4
+#define	MAX_RDV		16
+#define	MAX_INT		256
+#define	MAX_CONF	16
+#define	MAX_REGION	16
+#define	MAX_IO		4
+#define	MAX_PCI		4
+
+#define	BLKSZ		4096	/* memory block size */
+#define	TEST_TMO	60	/* time limit of a test case (sec) */
+
+/*
+	kernel lock: task state, wakeup count
+		* interrupt lock (DI) is taken before it, never after
+*/
+LOCAL	pthread_mutex_t	TkLock = PTHREAD_MUTEX_INITIALIZER;
+LOCAL	pthread_mutex_t	IntLock;
+LOCAL	pthread_condattr_t	CondAttr;
+LOCAL	pthread_once_t	Once = PTHREAD_ONCE_INIT;
+
+LOCAL	void	initKernel(void)
+{
+	pthread_mutexattr_t	ma;
+
+	pthread_mutexattr_init(&ma);
+	pthread_mutexattr_settype(&ma, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&IntLock, &ma);
+
+	pthread_condattr_init(&CondAttr);
+	pthread_condattr_setclock(&CondAttr, CLOCK_MONOTONIC);
+	return;
+}
+
+EXPORT	UD	hostClock(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (UD)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* absolute time msec later, for timed wait */
+LOCAL	void	deadline(struct timespec *ts, W msec)
+{
+	clock_gettime(CLOCK_MONOTONIC, ts);
+	ts->tv_sec += msec / 1000;
+	ts->tv_nsec += (long)(msec % 1000) * 1000000;
+	if (ts->tv_nsec >= 1000000000) {
+		ts->tv_sec++;
+		ts->tv_nsec -= 1000000000;
+	}
+	return;
+}
+
+/* ------------------------------------------------------------------------ */
+/*
+	task
+		* a thread not created by vcre_tsk() (harness client) gets
+		  an ID when it first needs one
+*/
+struct _task {
+	BOOL		used;
+	BOOL		run;		/* thread exists */
+	pthread_t	th;
+	void		(*fn)();
+	INT		stacd;
+	W		wupcnt;
+	pthread_cond_t	cv;
+};
+
+LOCAL	struct _task	Task[MAX_TASK + 1];	/* #0 is not used */
+LOCAL	__thread ID	Self;
+
+LOCAL	ID	newTask(void (*fn)())
+{
+	ID	id;
+
+	pthread_once(&Once, initKernel);
+
+	pthread_mutex_lock(&TkLock);
+	for (id = 1; id <= MAX_TASK && Task[id].used; id++);
+	if (id > MAX_TASK) {
+		id = E_LIMIT;
+	} else {
+		memset(&Task[id], 0, sizeof(Task[id]));
+		Task[id].used = TRUE;
+		Task[id].fn = fn;
+		pthread_cond_init(&Task[id].cv, &CondAttr);
+	}
+	pthread_mutex_unlock(&TkLock);
+
+	return id;
+}
+
+LOCAL	struct _task	*selfTask(void)
+{
+	if (!Self) Self = newTask(NULL);
+	if (Self < 0) {
+		fprintf(stderr, "host: too many tasks\n");
+		abort();
+	}
+	return &Task[Self];
+}
+
+LOCAL	void	*taskEntry(void *arg)
+{
+	struct _task	*t = arg;
+
+	pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, NULL);
+	Self = t - Task;
+	(*t->fn)(t->stacd);
+	exd_tsk();
+	return NULL;
+}
+
+EXPORT	ID	vcre_tsk(T_CTSK *ctsk)
+{
+	return newTask(ctsk->task);
+}
+
+EXPORT	ER	sta_tsk(ID tskid, INT stacd)
+{
+	struct _task	*t;
+
+	if (tskid <= 0 || tskid > MAX_TASK || !Task[tskid].used) return E_ID;
+	t = &Task[tskid];
+	if (t->run) return E_OBJ;
+
+	t->stacd = stacd;
+	t->run = TRUE;
+	if (pthread_create(&t->th, NULL, taskEntry, t) != 0) {
+		t->run = FALSE;
+		return E_NOMEM;
+	}
+	return E_OK;
+}
+
+EXPORT	ER	ter_tsk(ID tskid)
+{
+	struct _task	*t;
+
+	if (tskid <= 0 || tskid > MAX_TASK || !Task[tskid].used) return E_ID;
+	t = &Task[tskid];
+	if (!t->run) return E_OBJ;
+
+	pthread_cancel(t->th);
+	pthread_join(t->th, NULL);
+	t->run = FALSE;
+	return E_OK;
+}
+
+EXPORT	ER	del_tsk(ID tskid)
+{
+	if (tskid <= 0 || tskid > MAX_TASK || !Task[tskid].used) return E_ID;
+	if (Task[tskid].run) return E_OBJ;
+
+	pthread_cond_destroy(&Task[tskid].cv);
+	Task[tskid].used = FALSE;
+	return E_OK;
+}
+
+EXPORT	void	ext_tsk(void)
+{
+	struct _task	*t = selfTask();
+
+	pthread_detach(t->th);
+	t->run = FALSE;
+	pthread_exit(NULL);
+}
+
+EXPORT	void	exd_tsk(void)
+{
+	struct _task	*t = selfTask();
+
+	pthread_detach(t->th);
+	t->run = FALSE;
+	t->used = FALSE;
+	pthread_exit(NULL);
+}
+
+EXPORT	ER	get_tid(ID *tskid)
+{
+	selfTask();
+	*tskid = Self;
+	return E_OK;
+}
+
+LOCAL	void	unlockTk(void *arg)
+{
+	pthread_mutex_unlock(&TkLock);
+	return;
+}
+
+EXPORT	ER	tslp_tsk(TMO tmout)
+{
+	ER	er;
+	struct timespec	ts;
+	struct _task	*t = selfTask();
+
+	if (tmout > 0) deadline(&ts, tmout);
+
+	er = E_OK;
+	pthread_mutex_lock(&TkLock);
+	pthread_cleanup_push(unlockTk, NULL);
+	while (t->wupcnt == 0 && er == E_OK) {
+		if (tmout == TMO_POL) {
+			er = E_TMOUT;
+		} else if (tmout < 0) {
+			pthread_cond_wait(&t->cv, &TkLock);
+		} else if (pthread_cond_timedwait(&t->cv, &TkLock, &ts) ==
+			   ETIMEDOUT) {
+			er = E_TMOUT;
+		}
+	}
+	if (er == E_OK) t->wupcnt--;
+	pthread_cleanup_pop(1);
+
+	return er;
+}
+
+EXPORT	ER	slp_tsk(void)
+{
+	return tslp_tsk(TMO_FEVR);
+}
+
+EXPORT	ER	wup_tsk(ID tskid)
+{
+	if (tskid <= 0 || tskid > MAX_TASK || !Task[tskid].used) return E_ID;
+
+	pthread_mutex_lock(&TkLock);
+	Task[tskid].wupcnt++;
+	pthread_cond_signal(&Task[tskid].cv);
+	pthread_mutex_unlock(&TkLock);
+
+	return E_OK;
+}
+
+EXPORT	ER	dly_tsk(DLYTIME dlytim)
+{
+	struct timespec	ts;
+
+	ts.tv_sec = dlytim / 1000;
+	ts.tv_nsec = (long)(dlytim % 1000) * 1000000;
+	while (nanosleep(&ts, &ts) < 0 && errno == EINTR);
+
+	return E_OK;
+}
+
+/* ------------------------------------------------------------------------ */
+/*
+	event flag, kernel lock protects the pattern
+*/
+struct _flg {
+	BOOL		used;
+	UINT		ptn;
+	pthread_cond_t	cv;
+};
+
+LOCAL	struct _flg	Flg[MAX_FLG + 1];	/* #0 is not used */
+
+#define	BAD_FLG(id)	((id) <= 0 || (id) > MAX_FLG || !Flg[id].used)
+
+EXPORT	ID	vcre_flg(T_CFLG *cflg)
+{
+	ID	id;
+
+	pthread_once(&Once, initKernel);
+
+	pthread_mutex_lock(&TkLock);
+	for (id = 1; id <= MAX_FLG && Flg[id].used; id++);
+	if (id > MAX_FLG) {
+		id = E_LIMIT;
+	} else {
+		Flg[id].used = TRUE;
+		Flg[id].ptn = cflg->iflgptn;
+		pthread_cond_init(&Flg[id].cv, &CondAttr);
+	}
+	pthread_mutex_unlock(&TkLock);
+
+	return id;
+}
+
+EXPORT	ER	del_flg(ID flgid)
+{
+	if (BAD_FLG(flgid)) return E_ID;
+
+	pthread_mutex_lock(&TkLock);
+	pthread_cond_destroy(&Flg[flgid].cv);
+	Flg[flgid].used = FALSE;
+	pthread_mutex_unlock(&TkLock);
+
+	return E_OK;
+}
+
+EXPORT	ER	set_flg(ID flgid, UINT setptn)
+{
+	if (BAD_FLG(flgid)) return E_ID;
+
+	pthread_mutex_lock(&TkLock);
+	Flg[flgid].ptn |= setptn;
+	pthread_cond_broadcast(&Flg[flgid].cv);
+	pthread_mutex_unlock(&TkLock);
+
+	return E_OK;
+}
+
+EXPORT	ER	clr_flg(ID flgid, UINT clrptn)
+{
+	if (BAD_FLG(flgid)) return E_ID;
+
+	pthread_mutex_lock(&TkLock);
+	Flg[flgid].ptn &= clrptn;
+	pthread_mutex_unlock(&TkLock);
+
+	return E_OK;
+}
+
+LOCAL	BOOL	flgMatch(UINT ptn, UINT waiptn, UINT wfmode)
+{
+	return (wfmode & TWF_ORW) ? (ptn & waiptn) != 0 :
+		(ptn & waiptn) == waiptn;
+}
+
+EXPORT	ER	twai_flg(UINT *p_flgptn, ID flgid, UINT waiptn, UINT wfmode,
+			 TMO tmout)
+{
+	ER	er;
+	struct _flg	*f;
+	struct timespec	ts;
+
+	if (BAD_FLG(flgid)) return E_ID;
+	if (waiptn == 0) return E_PAR;
+	f = &Flg[flgid];
+
+	if (tmout > 0) deadline(&ts, tmout);
+
+	er = E_OK;
+	pthread_mutex_lock(&TkLock);
+	pthread_cleanup_push(unlockTk, NULL);
+	while (!flgMatch(f->ptn, waiptn, wfmode) && er == E_OK) {
+		if (tmout == TMO_POL) {
+			er = E_TMOUT;
+		} else if (tmout < 0) {
+			pthread_cond_wait(&f->cv, &TkLock);
+		} else if (pthread_cond_timedwait(&f->cv, &TkLock, &ts) ==
+			   ETIMEDOUT) {
+			er = E_TMOUT;
+		}
+	}
+	if (er == E_OK) {
+		*p_flgptn = f->ptn;
+		if (wfmode & TWF_CLR) f->ptn = 0;
+	}
+	pthread_cleanup_pop(1);
+
+	return er;
+}
+
+EXPORT	ER	wai_flg(UINT *p_flgptn, ID flgid, UINT waiptn, UINT wfmode)
+{
+	return twai_flg(p_flgptn, flgid, waiptn, wfmode, TMO_FEVR);
+}
+
+/* ------------------------------------------------------------------------ */
+/*
+	rendezvous port, kernel lock protects the queues
+		* a call waits on the caller's stack until it is replied
+		* accepted call is found by its rendezvous number
+*/
+struct _rdv {
+	struct _rdv	*next;
+	UINT		ptn;
+	void		*msg;		/* call, and reply to it */
+	W		cmsgsz;
+	W		rmsgsz;		/* < 0: not replied yet */
+	pthread_cond_t	cv;
+};
+
+struct _por {
+	BOOL		used;
+	W		maxcmsz;
+	W		maxrmsz;
+	struct _rdv	*que;		/* calls not accepted yet */
+	pthread_cond_t	cv;		/* acceptors */
+};
+
+LOCAL	struct _por	Por[MAX_POR + 1];	/* #0 is not used */
+LOCAL	struct _rdv	*Rdv[MAX_RDV + 1];	/* accepted calls */
+
+#define	BAD_POR(id)	((id) <= 0 || (id) > MAX_POR || !Por[id].used)
+#define	NOT_REPLIED	(-1)
+
+EXPORT	ID	vcre_por(T_CPOR *cpor)
+{
+	ID	id;
+
+	pthread_once(&Once, initKernel);
+
+	pthread_mutex_lock(&TkLock);
+	for (id = 1; id <= MAX_POR && Por[id].used; id++);
+	if (id > MAX_POR) {
+		id = E_LIMIT;
+	} else {
+		Por[id].used = TRUE;
+		Por[id].maxcmsz = cpor->maxcmsz;
+		Por[id].maxrmsz = cpor->maxrmsz;
+		Por[id].que = NULL;
+		pthread_cond_init(&Por[id].cv, &CondAttr);
+	}
+	pthread_mutex_unlock(&TkLock);
+
+	return id;
+}
+
+/* calls not accepted yet end with E_DLT */
+EXPORT	ER	del_por(ID porid)
+{
+	struct _rdv	*r;
+
+	if (BAD_POR(porid)) return E_ID;
+
+	pthread_mutex_lock(&TkLock);
+	for (r = Por[porid].que; r != NULL; r = r->next) {
+		r->rmsgsz = E_DLT;
+		pthread_cond_signal(&r->cv);
+	}
+	pthread_cond_destroy(&Por[porid].cv);
+	Por[porid].used = FALSE;
+	pthread_mutex_unlock(&TkLock);
+
+	return E_OK;
+}
+
+EXPORT	W	cal_por(ID porid, UINT calptn, void *msg, W cmsgsz)
+{
+	W	n;
+	struct _rdv	rdv, **pp;
+
+	if (BAD_POR(porid)) return E_ID;
+	if (cmsgsz < 0 || cmsgsz > Por[porid].maxcmsz) return E_PAR;
+
+	rdv.next = NULL;
+	rdv.ptn = calptn;
+	rdv.msg = msg;
+	rdv.cmsgsz = cmsgsz;
+	rdv.rmsgsz = NOT_REPLIED;
+	pthread_cond_init(&rdv.cv, &CondAttr);
+
+	pthread_mutex_lock(&TkLock);
+	for (pp = &Por[porid].que; *pp != NULL; pp = &(*pp)->next);
+	*pp = &rdv;
+	pthread_cond_broadcast(&Por[porid].cv);
+
+	while (rdv.rmsgsz == NOT_REPLIED)
+		pthread_cond_wait(&rdv.cv, &TkLock);
+	n = rdv.rmsgsz;
+	pthread_mutex_unlock(&TkLock);
+
+	pthread_cond_destroy(&rdv.cv);
+	return n;
+}
+
+EXPORT	ER	acp_por(RNO *rdvno, void *msg, W *cmsgsz, ID porid,
+			UINT acpptn)
+{
+	ER	er;
+	RNO	rno;
+	struct _rdv	*r, **pp;
+
+	if (BAD_POR(porid)) return E_ID;
+
+	er = E_OK;
+	pthread_mutex_lock(&TkLock);
+	pthread_cleanup_push(unlockTk, NULL);
+	while (1) {
+		if (!Por[porid].used) {
+			er = E_DLT;
+			break;
+		}
+		for (pp = &Por[porid].que; *pp != NULL &&
+		     !((*pp)->ptn & acpptn); pp = &(*pp)->next);
+		if (*pp != NULL) break;
+		pthread_cond_wait(&Por[porid].cv, &TkLock);
+	}
+	if (er == E_OK) {
+		for (rno = 1; rno <= MAX_RDV && Rdv[rno] != NULL; rno++);
+		if (rno > MAX_RDV) {
+			er = E_LIMIT;
+		} else {
+			r = *pp;
+			*pp = r->next;
+			Rdv[rno] = r;
+			memcpy(msg, r->msg, r->cmsgsz);
+			*cmsgsz = r->cmsgsz;
+			*rdvno = rno;
+		}
+	}
+	pthread_cleanup_pop(1);
+
+	return er;
+}
+
+EXPORT	ER	rpl_rdv(RNO rdvno, void *msg, W rmsgsz)
+{
+	ER	er;
+	struct _rdv	*r;
+
+	if (rdvno <= 0 || rdvno > MAX_RDV) return E_OBJ;
+
+	pthread_mutex_lock(&TkLock);
+	if ((r = Rdv[rdvno]) == NULL) {
+		er = E_OBJ;
+	} else {
+		memcpy(r->msg, msg, rmsgsz);
+		r->rmsgsz = rmsgsz;
+		pthread_cond_signal(&r->cv);
+		Rdv[rdvno] = NULL;
+		er = E_OK;
+	}
+	pthread_mutex_unlock(&TkLock);
+
+	return er;
+}
+
+/* ------------------------------------------------------------------------ */
+/*
+	cyclic handler: a thread per handler, handler runs with
+	interrupts disabled
+*/
+struct _cyc {
+	BOOL		used;
+	volatile BOOL	act;
+	pthread_t	th;
+	T_CCYC		c;
+};
+
+LOCAL	struct _cyc	Cyc[MAX_CYC + 1];	/* #0 is not used */
+
+LOCAL	void	*cycEntry(void *arg)
+{
+	UINT	imask;
+	struct _cyc	*c = arg;
+
+	dly_tsk(c->c.cycphs);
+	while (1) {
+		if (c->act) {
+			DI(imask);
+			(*c->c.cychdr)(c->c.exinf);
+			EI(imask);
+		}
+		dly_tsk(c->c.cyctim);
+	}
+	return NULL;
+}
+
+EXPORT	ID	vcre_cyc(T_CCYC *ccyc)
+{
+	ID	id;
+
+	pthread_once(&Once, initKernel);
+	if (ccyc->cyctim <= 0) return E_PAR;
+
+	for (id = 1; id <= MAX_CYC && Cyc[id].used; id++);
+	if (id > MAX_CYC) return E_LIMIT;
+
+	Cyc[id].c = *ccyc;
+	Cyc[id].act = (ccyc->cycatr & TA_STA) != 0;
+	if (pthread_create(&Cyc[id].th, NULL, cycEntry, &Cyc[id]) != 0)
+		return E_NOMEM;
+	Cyc[id].used = TRUE;
+
+	return id;
+}
+
+EXPORT	ER	del_cyc(ID cycid)
+{
+	if (cycid <= 0 || cycid > MAX_CYC || !Cyc[cycid].used) return E_ID;
+
+	pthread_cancel(Cyc[cycid].th);
+	pthread_join(Cyc[cycid].th, NULL);
+	Cyc[cycid].used = FALSE;
+	return E_OK;
+}
+
+EXPORT	ER	sta_cyc(ID cycid)
+{
+	if (cycid <= 0 || cycid > MAX_CYC || !Cyc[cycid].used) return E_ID;
+	Cyc[cycid].act = TRUE;
+	return E_OK;
+}
+
+EXPORT	ER	stp_cyc(ID cycid)
+{
+	if (cycid <= 0 || cycid > MAX_CYC || !Cyc[cycid].used) return E_ID;
+	Cyc[cycid].act = FALSE;
+	return E_OK;
+}
+
+/* ------------------------------------------------------------------------ */
+/*
+	interrupt: DI excludes handlers and other DI sections
+*/
+LOCAL	struct {
+	void	(*hdr)(UINT dintno);
+	BOOL	ena;
+} IntVec[MAX_INT];
+
+EXPORT	UINT	hostDI(void)
+{
+	pthread_once(&Once, initKernel);
+	pthread_mutex_lock(&IntLock);
+	return 0;
+}
+
+EXPORT	void	hostEI(UINT imask)
+{
+	pthread_mutex_unlock(&IntLock);
+	return;
+}
+
+EXPORT	ER	def_int(UINT dintno, T_DINT *pk_dint)
+{
+	if (dintno >= MAX_INT) return E_PAR;
+	IntVec[dintno].hdr = (pk_dint != NULL) ? pk_dint->inthdr : NULL;
+	return E_OK;
+}
+
+EXPORT	void	SetIntMode(UINT intvec, UINT mode)
+{
+	return;
+}
+
+EXPORT	void	EnableInt(UINT intvec)
+{
+	if (intvec < MAX_INT) IntVec[intvec].ena = TRUE;
+	return;
+}
+
+EXPORT	void	DisableInt(UINT intvec)
+{
+	if (intvec < MAX_INT) IntVec[intvec].ena = FALSE;
+	return;
+}
+
+EXPORT	void	EndOfInt(UINT intvec)
+{
+	return;
+}
+
+EXPORT	void	hostRaiseInt(UINT intvec)
+{
+	UINT	imask;
+
+	if (intvec >= MAX_INT) return;
+
+	DI(imask);
+	if (IntVec[intvec].ena && IntVec[intvec].hdr != NULL)
+		(*IntVec[intvec].hdr)(intvec);
+	EI(imask);
+	return;
+}
+
+/* ------------------------------------------------------------------------ */
+/*
+	fast lock, misuse (recursion, unlock by others) aborts
+*/
+EXPORT	ER	CreateLockWN(FastLock *lock, CONST B *name)
+{
+	pthread_mutexattr_t	ma;
+
+	pthread_mutexattr_init(&ma);
+	pthread_mutexattr_settype(&ma, PTHREAD_MUTEX_ERRORCHECK);
+	return (pthread_mutex_init(&lock->mtx, &ma) == 0) ? E_OK : E_NOMEM;
+}
+
+EXPORT	void	DeleteLock(FastLock *lock)
+{
+	pthread_mutex_destroy(&lock->mtx);
+	return;
+}
+
+EXPORT	void	Lock(FastLock *lock)
+{
+	if (pthread_mutex_lock(&lock->mtx) != 0) {
+		fprintf(stderr, "host: Lock() failed (recursive?)\n");
+		abort();
+	}
+	return;
+}
+
+EXPORT	void	Unlock(FastLock *lock)
+{
+	if (pthread_mutex_unlock(&lock->mtx) != 0) {
+		fprintf(stderr, "host: Unlock() failed (not owner?)\n");
+		abort();
+	}
+	return;
+}
+
+/* ------------------------------------------------------------------------ */
+/*
+	device management: the screen driver is the only device
+		* request is a rendezvous call as the device manager
+		  makes it, harness clients share one address space
+*/
+LOCAL	ID	DevPort;
+
+EXPORT	ER	DefDevice(CONST DevDef *ddef, void *rsv)
+{
+	DevPort = (ddef->portid > 0) ? ddef->portid : 0;
+	return E_OK;
+}
+
+EXPORT	ERR	hostDevReq(W cmd, W datano, void *buf, W size, W *asize)
+{
+	W	n;
+	union {
+		DevReq	q;
+		DevRsp	r;
+	} msg;
+
+	if (DevPort <= 0) return E_NOEXS;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.q.cmd.cmd = cmd;
+	msg.q.cmd.adcnv = 1;
+	msg.q.datano = datano;
+	msg.q.datacnt = size;
+	msg.q.memptr = buf;
+
+	n = cal_por(DevPort, D_NORM_PTN, &msg, sizeof(DevReq));
+	if (n < E_OK) return n;
+	if (n != sizeof(DevRsp)) return E_OBJ;
+
+	if (asize != NULL) *asize = msg.r.datacnt;
+	return msg.r.error.err;
+}
+
+EXPORT	ER	SetTaskSpace(ID tskid)
+{
+	return E_OK;
+}
+
+EXPORT	ER	CheckSpaceR(void *addr, W len)
+{
+	return (addr != NULL && len >= 0) ? E_OK : ER_ADR;
+}
+
+EXPORT	ER	CheckSpaceRW(void *addr, W len)
+{
+	return CheckSpaceR(addr, len);
+}
+
+/* decimal number of TRON code */
+EXPORT	long	tc_strtol(CONST TC *str, TC **endptr, int base)
+{
+	long	v;
+
+	for (v = 0; *str >= TK_0 && *str <= TK_9; str++)
+		v = v * 10 + (*str - TK_0);
+	if (endptr != NULL) *endptr = (TC *)str;
+
+	return v;
+}
+
+/* ------------------------------------------------------------------------ */
+/*
+	device configuration
+*/
+LOCAL	struct {
+	B	name[32];
+	W	n;
+	W	val[8];
+} Conf[MAX_CONF];
+
+EXPORT	void	hostSetConf(CONST B *name, W n, ...)
+{
+	W	i, j;
+	va_list	ap;
+
+	for (i = 0; i < MAX_CONF && Conf[i].name[0] &&
+	     strcmp((char *)Conf[i].name, (char *)name); i++);
+	if (i >= MAX_CONF || n > 8) return;
+
+	strncpy((char *)Conf[i].name, (char *)name, sizeof(Conf[i].name) - 1);
+	Conf[i].n = n;
+	va_start(ap, n);
+	for (j = 0; j < n; j++) Conf[i].val[j] = va_arg(ap, W);
+	va_end(ap);
+
+	return;
+}
+
+EXPORT	void	hostClearConf(void)
+{
+	memset(Conf, 0, sizeof(Conf));
+	return;
+}
+
+EXPORT	W	GetDevConf(CONST B *name, W *val)
+{
+	W	i;
+
+	for (i = 0; i < MAX_CONF && Conf[i].name[0]; i++) {
+		if (strcmp((char *)Conf[i].name, (char *)name)) continue;
+		memcpy(val, Conf[i].val, sizeof(W) * Conf[i].n);
+		return Conf[i].n;
+	}
+	return E_NOEXS;
+}
+
+/* ------------------------------------------------------------------------ */
+/*
+	memory
+*/
+EXPORT	ER	b_mbk_sts(M_STATE *sts)
+{
+	sts->blksz = BLKSZ;
+	sts->total = sts->free = 0x40000;	/* 1GB */
+	return E_OK;
+}
+
+EXPORT	ER	b_get_mbk(void *blk, W nblk, UW attr)
+{
+	void	*p;
+
+	if (nblk <= 0) return E_PAR;
+	if (posix_memalign(&p, BLKSZ, (size_t)nblk * BLKSZ) != 0)
+		return E_NOMEM;
+	memset(p, 0, (size_t)nblk * BLKSZ);
+
+	*(void **)blk = p;
+	return E_OK;
+}
+
+EXPORT	ER	b_rel_mbk(void *blk)
+{
+	free(blk);
+	return E_OK;
+}
+
+/*
+	"physical" memory: device regions, and pages mapped by
+	MapMemory(NULL) which get an address above the devices
+*/
+LOCAL	struct {
+	UW	paddr;
+	W	size;
+	UB	*laddr;
+} Region[MAX_REGION];
+
+LOCAL	UW	NextPhys = 0xc0000000;
+
+EXPORT	void	hostAddRegion(UW paddr, W size, void *laddr)
+{
+	W	i;
+
+	for (i = 0; i < MAX_REGION && Region[i].size > 0 &&
+	     Region[i].paddr != paddr; i++);
+	if (i >= MAX_REGION) return;
+
+	Region[i].paddr = paddr;
+	Region[i].size = size;
+	Region[i].laddr = laddr;
+	return;
+}
+
+EXPORT	ER	MapMemory(void *paddr, W len, UINT attr, void **laddr)
+{
+	W	i;
+	UW	pa;
+	void	*p;
+
+	/* new pages */
+	if (paddr == NULL) {
+		if (b_get_mbk(&p, (len + BLKSZ - 1) / BLKSZ, 0) < E_OK)
+			return E_NOMEM;
+		hostAddRegion(NextPhys, len, p);
+		NextPhys += (len + BLKSZ - 1) & ~(BLKSZ - 1);
+		*laddr = p;
+		return E_OK;
+	}
+
+	pa = (UW)(size_t)paddr;
+	for (i = 0; i < MAX_REGION && Region[i].size > 0; i++) {
+		if (pa < Region[i].paddr ||
+		    pa + len > Region[i].paddr + Region[i].size) continue;
+		*laddr = Region[i].laddr + (pa - Region[i].paddr);
+		return E_OK;
+	}
+	return E_PAR;
+}
+
+EXPORT	ER	UnmapMemory(void *laddr)
+{
+	return E_OK;
+}
+
+EXPORT	W	CnvPhysicalAddr(void *laddr, W len, void **paddr)
+{
+	W	i;
+	UB	*la = laddr;
+
+	for (i = 0; i < MAX_REGION && Region[i].size > 0; i++) {
+		if (la < Region[i].laddr ||
+		    la >= Region[i].laddr + Region[i].size) continue;
+		*paddr = (void *)(size_t)(Region[i].paddr +
+					  (la - Region[i].laddr));
+		return Region[i].laddr + Region[i].size - la;
+	}
+	return E_PAR;
+}
+
+/* ------------------------------------------------------------------------ */
+/*
+	I/O port
+*/
+LOCAL	HostIO	*IO[MAX_IO];
+
+EXPORT	void	hostAddIO(HostIO *io)
+{
+	W	i;
+
+	for (i = 0; i < MAX_IO && IO[i] != NULL && IO[i] != io; i++);
+	if (i < MAX_IO) IO[i] = io;
+	return;
+}
+
+LOCAL	HostIO	*findIO(UW port)
+{
+	W	i;
+
+	for (i = 0; i < MAX_IO && IO[i] != NULL; i++) {
+		if (port >= IO[i]->base && port < IO[i]->base + IO[i]->size)
+			return IO[i];
+	}
+	return NULL;
+}
+
+EXPORT	void	out_w(UW port, UW data)
+{
+	HostIO	*io = findIO(port);
+
+	if (io != NULL) (*io->out)(port - io->base, data);
+	return;
+}
+
+EXPORT	UW	in_w(UW port)
+{
+	HostIO	*io = findIO(port);
+
+	return (io != NULL) ? (*io->in)(port - io->base) : ~0U;
+}
+
+EXPORT	void	out_h(UW port, UH data)
+{
+	out_w(port, data);
+	return;
+}
+
+EXPORT	UH	in_h(UW port)
+{
+	return in_w(port);
+}
+
+EXPORT	void	out_b(UW port, UB data)
+{
+	out_w(port, data);
+	return;
+}
+
+EXPORT	UB	in_b(UW port)
+{
+	return in_w(port);
+}
+
+/* ------------------------------------------------------------------------ */
+/*
+	PCI configuration space
+*/
+LOCAL	struct {
+	UH	vendor, device;
+	UH	command;
+	UW	bar[3];
+	UB	intline;
+} Pci[MAX_PCI];
+
+LOCAL	W	NumPci;
+
+EXPORT	void	hostAddPci(UH vendor, UH device, UW *bar, UB intline)
+{
+	W	i;
+
+	for (i = 0; i < NumPci && (Pci[i].vendor != vendor ||
+				   Pci[i].device != device); i++);
+	if (i >= MAX_PCI) return;
+	if (i == NumPci) NumPci++;
+
+	Pci[i].vendor = vendor;
+	Pci[i].device = device;
+	Pci[i].command = 0;
+	memcpy(Pci[i].bar, bar, sizeof(Pci[i].bar));
+	Pci[i].intline = intline;
+	return;
+}
+
+EXPORT	W	searchPciDev(UH vendor, UH device)
+{
+	W	i;
+
+	for (i = 0; i < NumPci; i++) {
+		if (Pci[i].vendor == vendor && Pci[i].device == device)
+			return i;
+	}
+	return -1;
+}
+
+EXPORT	UW	inPciConfW(W pciaddr, W reg)
+{
+	if (pciaddr < 0 || pciaddr >= NumPci) return ~0U;
+
+	switch (reg) {
+	case PCR_BASEADDR_0:
+	case PCR_BASEADDR_1:
+	case PCR_BASEADDR_2:
+		return Pci[pciaddr].bar[(reg - PCR_BASEADDR_0) / 4];
+	case PCR_COMMAND:
+		return Pci[pciaddr].command;
+	case 0:
+		return (Pci[pciaddr].device << 16) | Pci[pciaddr].vendor;
+	}
+	return 0;
+}
+
+EXPORT	UH	inPciConfH(W pciaddr, W reg)
+{
+	return inPciConfW(pciaddr, reg & ~3) >> ((reg & 2) * 8);
+}
+
+EXPORT	UB	inPciConfB(W pciaddr, W reg)
+{
+	if (pciaddr < 0 || pciaddr >= NumPci) return 0xff;
+	if (reg == 0x3c) return Pci[pciaddr].intline;
+	return inPciConfW(pciaddr, reg & ~3) >> ((reg & 3) * 8);
+}
+
+EXPORT	void	outPciConfH(W pciaddr, W reg, UH data)
+{
+	if (pciaddr >= 0 && pciaddr < NumPci && reg == PCR_COMMAND)
+		Pci[pciaddr].command = data;
+	return;
+}
+
+/* ------------------------------------------------------------------------ */
+/*
+	run a test case in a child process, driver state is not reused
+*/
+EXPORT	BOOL	hostRun(CONST B *name, BOOL (*fn)(void))
+{
+	pid_t	pid;
+	int	sts;
+
+	fflush(stdout);
+	pid = fork();
+	if (pid == 0) {
+		alarm(TEST_TMO);	/* hang is a failure */
+		sts = (*fn)() ? 0 : 1;
+		fflush(stdout);
+		_exit(sts);
+	}
+
+	if (pid < 0 || waitpid(pid, &sts, 0) < 0) sts = -1;
+
+	if (WIFEXITED(sts) && WEXITSTATUS(sts) == 0) {
+		printf("ok   %s\n", name);
+		return TRUE;
+	}
+	printf("NG   %s%s\n", name, WIFSIGNALED(sts) ? " (signal)" : "");
+	return FALSE;
+}
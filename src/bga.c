@@ -11,15 +11,16 @@
 #include <driver/pcat/sys.h>
 #include <kernel/segment.h>
 #include <bsys/util.h>
+#include <btron/memory.h>
 
 #ifdef USE_DEVICE_VIDEOMODE_H
 #define	VIDEOMODE	DM1600x32
+#define	SUPPORT_MODEMAP	(1 << VIDEOMODE)
 #else
 #define	VIDEOMODE	0
+#define	SUPPORT_MODEMAP	ALL_VIDEO_MODE
 #endif
 
-#define	SUPPORT_MODEMAP	(1 << VIDEOMODE)
-
 #define	VENDOR_BOCHS	0x1234
 #define	DEVICE_BGA	0x1111
 
@@ -32,16 +33,28 @@
 #define	PALETTE_INDEX	0x3c8
 #define	PALETTE_DATA	0x3c9
 
+#define	PALETTE_BURST	64	/* entries written with interrupt disabled */
+
+#define	INPUT_STATUS1	0x3da
+#define	VRETRACE	0x08
+#define	VRETRACE_POLL	1	/* sampling interval of retrace (msec) */
+
 #define	regID		0
 #define	regXRES		1
 #define	regYRES		2
 #define	regBPP		3
 #define	regENABLE	4
+#define	regENABLE_GETCAPS	0x02
+#define	regVIRT_WIDTH	6
+#define	regVIRT_HEIGHT	7
+#define	regX_OFFSET	8
+#define	regY_OFFSET	9
 
 #define	SUPPORT_BGA_ID	0xb0c4
 #define	BGA_VRAM_SIZE	((BGA_ID == SUPPORT_BGA_ID) ? 8388608 : 16777216)
 
 LOCAL	UH	BGA_ID;
+LOCAL	UH	BGA_MAXX, BGA_MAXY;
 
 Inline	void	WriteBGA(UH index, UH value)
 {
@@ -56,6 +69,26 @@ Inline	UH	ReadBGA(UH index)
 	return in_h(BGA_DATA);
 }
 
+/* copy updated region from virtual VRAM to FrameBuffer */
+LOCAL	void	BGAflush(RECT *rp, W n)
+{
+	W	y, ofs, len, n0;
+
+	for (n0 = n; n > 0; n--, rp++) {
+		ofs = rp->c.top * Vinf.rowbytes + rp->c.left * Vinf.pixbyte;
+		len = (rp->c.right - rp->c.left) * Vinf.pixbyte;
+		for (y = rp->c.top; y < rp->c.bottom; y++) {
+			memcpy(Vinf.f_addr + ofs, Vinf.v_addr + ofs, len);
+			ofs += Vinf.rowbytes;
+		}
+		STAT_ADD(copybytes, len * (rp->c.bottom - rp->c.top));
+	}
+	drawCursor(rp - n0, n0);	/* on top of what was copied */
+	flushWC();
+
+	return;
+}
+
 LOCAL	ERR	BGAinit(void)
 {
 	ERR	err;
@@ -70,44 +103,118 @@ LOCAL	ERR	BGAinit(void)
 		goto fin0;
 	}
 
-	/* map FrameBuffer */
 	Vinf.framebuf_addr =
 		(void *)(inPciConfW(Vinf.pciaddr, PCR_BASEADDR_0) & ~0x0f);
 	Vinf.framebuf_total = BGA_VRAM_SIZE;
-	err = mapFrameBuf(Vinf.framebuf_addr, Vinf.framebuf_total,
-			 &Vinf.f_addr);
-	if (err < ER_OK) goto fin0;
+
+	/* maximum resolution */
+	WriteBGA(regENABLE, regENABLE_GETCAPS);
+	BGA_MAXX = ReadBGA(regXRES);
+	BGA_MAXY = ReadBGA(regYRES);
+	WriteBGA(regENABLE, 0);
 
 	err = ER_OK;
 fin0:
 	return err;
 }
 
-/* set color map */
+/* set color map, called only when color map is used */
 LOCAL	void	BGAsetcmap(COLOR *cmap, W index, W entries)
 {
-#if defined(COLOR_CMAP256)
-	W	i;
+	W	i, n;
 	UW	imask;
 
-	for (i = 0; i < entries; i++) {
+	STAT_ADD(palette, entries);
+	for (; entries > 0; entries -= n, index += n) {
+		n = (entries < PALETTE_BURST) ? entries : PALETTE_BURST;
+
+		/* DAC index is incremented automatically */
 		DI(imask);
 		out_b(PALETTE_INDEX, index);
-		out_b(PALETTE_DATA, *cmap >> 16);
-		out_b(PALETTE_DATA, *cmap >> 8);
-		out_b(PALETTE_DATA, *cmap);
-		cmap++;
-		index++;
+		for (i = 0; i < n; i++) {
+			out_b(PALETTE_DATA, *cmap >> 16);
+			out_b(PALETTE_DATA, *cmap >> 8);
+			out_b(PALETTE_DATA, *cmap);
+			cmap++;
+		}
 		EI(imask);
 	}
+	return;
+}
 
-#else
-	/* no support, do nothing */
+/*
+	wait for the beginning of vertical retrace
+		* port read traps to the hypervisor, it is sampled once per
+		  VRETRACE_POLL instead of busy polling
+		* gives up after a frame time (MIN_VFREQ if not known)
+*/
+LOCAL	void	BGAwaitvsync(void)
+{
+	W	t, frame;
+
+	frame = 1000 / ((Vinf.vfreq > 0) ? Vinf.vfreq : MIN_VFREQ);
+
+	for (t = 0; t < frame && (in_b(INPUT_STATUS1) & VRETRACE);
+	     t += VRETRACE_POLL) dly_tsk(VRETRACE_POLL);
+	for (; t < frame && !(in_b(INPUT_STATUS1) & VRETRACE);
+	     t += VRETRACE_POLL) dly_tsk(VRETRACE_POLL);
+
+	return;
+}
+
+/* page flip */
+LOCAL	ERR	BGAflip(W buf, W mode)
+{
+	if (mode == FLIP_VSYNC) BGAwaitvsync();
+
+	/* Y offset is latched by the next refresh */
+	WriteBGA(regY_OFFSET, Vinf.fb_height * buf);
+
+	return ER_OK;
+}
+
+/* page flip buffers in the rest of FrameBuffer */
+LOCAL	void	BGAflipbuf(void)
+{
+	Vinf.flipbuf = Vinf.framebuf_total / Vinf.vramsz;
+	if (Vinf.flipbuf > MAX_FLIPBUF) Vinf.flipbuf = MAX_FLIPBUF;
+	WriteBGA(regVIRT_HEIGHT, Vinf.fb_height * Vinf.flipbuf);
 
-#endif
 	return;
 }
 
+/* viewport, virtual screen is changed if width > 0 */
+LOCAL	ERR	BGAview(W width, W height, W x, W y)
+{
+	if (width > 0) {
+		/* chip rejects width it can not place in VRAM */
+		WriteBGA(regVIRT_WIDTH, width);
+		if (ReadBGA(regVIRT_WIDTH) != width) {
+			WriteBGA(regVIRT_WIDTH, Vinf.width);
+			return ER_PAR;
+		}
+
+		Vinf.width = Vinf.fb_width = width;
+		Vinf.height = Vinf.fb_height = height;
+		Vinf.rowbytes = Vinf.framebuf_rowb = width * Vinf.pixbyte;
+		Vinf.vramsz = Vinf.rowbytes * Vinf.fb_height;
+
+		/* Y offset is either viewport or flip buffer */
+		Vinf.flipbuf = Vinf.flipfront = Vinf.flipprev = 0;
+		if (width == Vinf.act_width && height == Vinf.act_height) {
+			BGAflipbuf();
+		} else {
+			WriteBGA(regVIRT_HEIGHT, height);
+		}
+	}
+
+	/* offset is latched by the next refresh */
+	WriteBGA(regX_OFFSET, x);
+	WriteBGA(regY_OFFSET, y);
+
+	return ER_OK;
+}
+
 /* set display mode */
 LOCAL	void	BGAsetmode(W flg)
 {
@@ -118,8 +225,8 @@ LOCAL	void	BGAsetmode(W flg)
 	/* exit */
 	if (flg < 0) return;
 
-	/* enter BGA mode */
-	bpp = (Vinf.pixbits >> 8) & 0xff;
+	/* enter BGA mode, scanout format may differ from virtual VRAM */
+	bpp = (ScanBits >> 8) & 0xff;
 
 	WriteBGA(regXRES, Vinf.act_width);
 	WriteBGA(regYRES, Vinf.act_height);
@@ -129,8 +236,17 @@ LOCAL	void	BGAsetmode(W flg)
 	/* fix display mode information */
 	Vinf.width = Vinf.fb_width = Vinf.act_width;
 	Vinf.height = Vinf.fb_height = Vinf.act_height;
-	Vinf.rowbytes = Vinf.framebuf_rowb = Vinf.act_width * (bpp / 8);
-	Vinf.vramsz = Vinf.framebuf_rowb * Vinf.fb_height;
+	Vinf.framebuf_rowb = Vinf.act_width * (bpp / 8);
+	Vinf.rowbytes = Vinf.act_width * Vinf.pixbyte;
+	Vinf.vramsz = Vinf.rowbytes * Vinf.fb_height;
+
+	/* page flip buffers in the rest of FrameBuffer */
+	Vinf.flipbuf = Vinf.flipfront = Vinf.flipprev = 0;
+	if (!(Vinf.attr & USE_VVRAM)) {
+		BGAflipbuf();
+		WriteBGA(regX_OFFSET, 0);
+		WriteBGA(regY_OFFSET, 0);
+	}
 
 	return;
 }
@@ -152,25 +268,52 @@ EXPORT	W	BGAInit(void)
 	if (err < ER_OK) goto fin0;
 
 	/* set Vinf */
-	Vinf.reqmode = Vinf.curmode = VIDEOMODE;
+	setModeMap(SUPPORT_MODEMAP, VIDEOMODE, BGA_MAXX, BGA_MAXY);
 	// Vinf.framebuf_addr is already set
-	// Vinf.f_addr is already set
+	// Vinf.f_addr is set below
 	strncpy(Vinf.chipinf, "Bochs Graphics Adapter", L_CHIPINF);
 	// Vinf.framebuf_total is already set
 	Vinf.attr |= (LINEAR_FRAMEBUF | NEED_FINPROC);
-	Vinf.attr &= ~(BPP_24 | USE_VVRAM);
+	Vinf.attr &= ~BPP_24;
 	Vinf.fn_setcmap = BGAsetcmap;
 	Vinf.fn_setmode = BGAsetmode;
-	Vinf.modemap = SUPPORT_MODEMAP;
+	Vinf.fn_flip = BGAflip;
+	Vinf.fn_view = BGAview;
 
 	/* these values are temporally, fix them at BGAsetmode() */
 	Vinf.fb_width = Vinf.framebuf_rowb = VideoHsize(Vinf.reqmode);
 	Vinf.fb_height = VideoVsize(Vinf.reqmode);
 	Vinf.framebuf_rowb *= (VideoPixBits(Vinf.reqmode) >> 11) & 0x1f;
 
+	/* virtual VRAM is optional (VIDEOATTR, VIDEOSCANOUT) */
+	if ((Vinf.attr & USE_VVRAM) &&
+	    (allocVVRAM() < ER_OK ||
+	     initDamage(DMG_TILE, Vinf.scanbits ? convRect : BGAflush) <
+	     ER_OK)) {
+		if (Vinf.v_addr != NULL) b_rel_mbk(Vinf.v_addr);
+		Vinf.v_addr = NULL;
+		Vinf.v_size = 0;
+		Vinf.attr &= ~USE_VVRAM;
+		Vinf.scanbits = 0;
+	}
+
+	if (Vinf.attr & USE_VVRAM) Vinf.fn_updscr = addDamage;
+
+	/* map whole FrameBuffer, it is not remapped at mode change */
+	err = allocFrameBuf();
+	if (err < ER_OK) goto fin1;
+
 	err = 1;
 	goto fin0;
 
+fin1:
+	if (Vinf.attr & USE_VVRAM) {
+		finishDamage();
+		b_rel_mbk(Vinf.v_addr);
+		Vinf.v_addr = NULL;
+		Vinf.v_size = 0;
+		Vinf.fn_updscr = NULL;
+	}
 fin0:
 	return err;
 }
@@ -0,0 +1,196 @@
+/*
+	capture.c	screen driver
+	screen capture (DN_SCRCAPTURE)
+
+	Copyright 2026 by agent
+	This software is distributed under the T-License 2.0.
+*/
+#include "screen.h"
+
+#define	CAPT_CHUNK	128	/* pixels read at once before conversion */
+
+/*
+	FrameBuffer is mapped uncached or write-combining, every load is
+	a bus cycle: read it in 16 bytes, SSE4.1 streaming load is fast
+	on write-combining memory
+*/
+__attribute__((target("sse2")))
+LOCAL	void	readRowSSE2(UB *d, UB *s, W len)
+{
+	for (; ((UW)s & 15) && len > 0; len--) *d++ = *s++;
+
+	for (; len >= 64; len -= 64, s += 64, d += 64) {
+		__asm__ __volatile__ ("movdqa   (%0), %%xmm0\n\t"
+				      "movdqa 16(%0), %%xmm1\n\t"
+				      "movdqa 32(%0), %%xmm2\n\t"
+				      "movdqa 48(%0), %%xmm3\n\t"
+				      "movdqu %%xmm0,   (%1)\n\t"
+				      "movdqu %%xmm1, 16(%1)\n\t"
+				      "movdqu %%xmm2, 32(%1)\n\t"
+				      "movdqu %%xmm3, 48(%1)"
+				      : : "r"(s), "r"(d)
+				      : "memory", "xmm0", "xmm1", "xmm2", "xmm3");
+	}
+	if (len > 0) memcpy(d, s, len);
+
+	return;
+}
+
+__attribute__((target("sse4.1")))
+LOCAL	void	readRowSSE41(UB *d, UB *s, W len)
+{
+	for (; ((UW)s & 15) && len > 0; len--) *d++ = *s++;
+
+	for (; len >= 64; len -= 64, s += 64, d += 64) {
+		__asm__ __volatile__ ("movntdqa   (%0), %%xmm0\n\t"
+				      "movntdqa 16(%0), %%xmm1\n\t"
+				      "movntdqa 32(%0), %%xmm2\n\t"
+				      "movntdqa 48(%0), %%xmm3\n\t"
+				      "movdqu %%xmm0,   (%1)\n\t"
+				      "movdqu %%xmm1, 16(%1)\n\t"
+				      "movdqu %%xmm2, 32(%1)\n\t"
+				      "movdqu %%xmm3, 48(%1)"
+				      : : "r"(s), "r"(d)
+				      : "memory", "xmm0", "xmm1", "xmm2", "xmm3");
+	}
+	if (len > 0) memcpy(d, s, len);
+
+	return;
+}
+
+/* copy r of screen to d, conversion to xRGB8888 if conv */
+LOCAL	void	captureRect(UB *d, W pitch, RECT *r, BOOL conv)
+{
+	W	x, y, w, n, pb;
+	UB	*s, tmp[CAPT_CHUNK * sizeof(UW)];
+	void	(*readRow)(UB *d, UB *s, W len);
+
+	/* separate virtual VRAM is cacheable, FrameBuffer is not */
+	if (Vinf.v_addr != NULL && Vinf.v_addr != Vinf.f_addr) {
+		readRow = copyRow;
+	} else if (CpuSIMD >= SIMD_SSE41) {
+		readRow = readRowSSE41;
+	} else if (CpuSIMD >= SIMD_SSE2) {
+		readRow = readRowSSE2;
+	} else {
+		readRow = copyRow;
+	}
+
+	pb = Vinf.pixbyte;
+	w = r->c.right - r->c.left;
+	s = (UB *)Vinf.baseaddr + r->c.top * Vinf.rowbytes + r->c.left * pb;
+
+	for (y = r->c.top; y < r->c.bottom; y++) {
+		if (!conv) {
+			(*readRow)(d, s, w * pb);
+		} else if (Vinf.v_addr != NULL && Vinf.v_addr != Vinf.f_addr) {
+			expandRow(d, s, w, pb);
+		} else {
+			/* convert in cache, not reading FrameBuffer twice */
+			for (x = 0; x < w; x += n) {
+				n = (w - x < CAPT_CHUNK) ? w - x : CAPT_CHUNK;
+				(*readRow)(tmp, s + x * pb, n * pb);
+				expandRow(d + x * sizeof(UW), tmp, n, pb);
+			}
+		}
+		s += Vinf.rowbytes;
+		d += pitch;
+	}
+
+	return;
+}
+
+Inline	void	rectUnion(RECT *d, RECT *s)
+{
+	if (d->c.left >= d->c.right || d->c.top >= d->c.bottom) {
+		*d = *s;
+		return;
+	}
+	if (d->c.left > s->c.left) d->c.left = s->c.left;
+	if (d->c.top > s->c.top) d->c.top = s->c.top;
+	if (d->c.right < s->c.right) d->c.right = s->c.right;
+	if (d->c.bottom < s->c.bottom) d->c.bottom = s->c.bottom;
+	return;
+}
+
+/*
+	screen capture (DN_SCRCAPTURE)
+*/
+EXPORT	ERR	getSCRCAPTURE(ScrCapture *cap, W size)
+{
+	ERR	err;
+	W	w, h, ob, pitch, y, y0, c, c0, tw, th;
+	UW	mask, tile[DMG_TILEROW];
+	BOOL	conv;
+	UB	*data;
+	RECT	r;
+
+	w = cap->r.c.right - cap->r.c.left;
+	h = cap->r.c.bottom - cap->r.c.top;
+	if (cap->r.c.left < 0 || cap->r.c.top < 0 || w <= 0 || h <= 0 ||
+	    cap->r.c.right > Vinf.width || cap->r.c.bottom > Vinf.height ||
+	    (cap->mode != CAPT_ALL && cap->mode != CAPT_CHANGED)) {
+		err = ER_PAR;
+		goto fin0;
+	}
+
+	/* output format */
+	conv = (cap->pixbits != 0 && cap->pixbits != Vinf.pixbits);
+	if (conv && cap->pixbits != CAPT_XRGB) {
+		err = ER_PAR;
+		goto fin0;
+	}
+	ob = conv ? sizeof(UW) : Vinf.pixbyte;
+
+	pitch = w * ob;
+	if (size < (W)sizeof(ScrCapture) + pitch * h) {
+		err = ER_PAR;
+		goto fin0;
+	}
+	data = (UB *)(cap + 1);
+
+	/* everything, region changed is not known */
+	if (cap->mode == CAPT_ALL || !takeChanged(&cap->r, tile, &tw, &th)) {
+		captureRect(data, pitch, &cap->r, conv);
+		cap->changed = cap->r;
+		err = ER_OK;
+		goto fin0;
+	}
+
+	/* changed tiles in the rectangle */
+	cap->changed.c.left = cap->changed.c.right = 0;
+	cap->changed.c.top = cap->changed.c.bottom = 0;
+	for (y0 = cap->r.c.top / th; y0 * th < cap->r.c.bottom; y0 = y) {
+		/* rows having the same tile pattern are merged */
+		mask = tile[y0];
+		for (y = y0 + 1; y * th < cap->r.c.bottom && tile[y] == mask;
+		     y++);
+		if (!mask) continue;
+
+		for (c = 0; c < 32; c++) {
+			if (!(mask & (1U << c))) continue;
+			for (c0 = c; c < 32 && (mask & (1U << c)); c++);
+
+			r.c.left = c0 * tw;
+			r.c.right = c * tw;
+			r.c.top = y0 * th;
+			r.c.bottom = y * th;
+			if (r.c.left < cap->r.c.left) r.c.left = cap->r.c.left;
+			if (r.c.top < cap->r.c.top) r.c.top = cap->r.c.top;
+			if (r.c.right > cap->r.c.right)
+				r.c.right = cap->r.c.right;
+			if (r.c.bottom > cap->r.c.bottom)
+				r.c.bottom = cap->r.c.bottom;
+			if (r.c.left >= r.c.right) continue;
+
+			captureRect(data + (r.c.top - cap->r.c.top) * pitch +
+				    (r.c.left - cap->r.c.left) * ob,
+				    pitch, &r, conv);
+			rectUnion(&cap->changed, &r);
+		}
+	}
+
+	err = ER_OK;
+fin0:
+	return err;
+}
@@ -24,6 +24,7 @@
 #include "screen.h"
 
 #include <kernel/segment.h>
+#include <btron/memory.h>
 #include "videomode.h"
 #include <tcode.h>
 
@@ -33,6 +34,67 @@ IMPORT	FUNCP	VideoFunc[];		/* video chip dependent processing functions */
 
 LOCAL	CONST	B	*OEMName = "T-Engine Video Device";
 
+/* issued present fences (DN_SCRFENCE) */
+#define	FENCE_HIST	64	/* power of 2 */
+
+LOCAL	struct {
+	FastLock	lock;
+	UW		seq;		/* last sequence number */
+	UW		done;		/* completed up to (statistics) */
+	UW		id[FENCE_HIST];	/* device fence ID (0: processed) */
+	UW		time[FENCE_HIST];	/* when inserted */
+} Fence;
+
+#ifndef USE_DEVICE_VIDEOMODE_H
+/* screen size of display mode (VIDEOMODE - 1) */
+EXPORT	CONST	UH	VideoModeSize[MAX_VIDEO_MODE][2] = {
+	{   0,    0},	/* depends on framebuffer size */
+	{ 640,  480},
+	{ 800,  600},
+	{1024,  768},
+	{1280,  720},
+	{1280, 1024},
+	{1600,  900},
+	{1920, 1080},
+	{1920, 1200},
+	{2560, 1440},
+	{2560, 1600},
+};
+
+/* color format, VIDEOMODE (2nd value) selects it by bits per pixel */
+LOCAL	CONST	VideoFormat	VideoFormatTab[] = {
+	{0x0808, 256, 0x0000, 0x0000, 0x0000},	/* 8bpp color map */
+	{0x1010,   0, 0x0b05, 0x0506, 0x0005},	/* RGB565 */
+	{0x2018,   0, 0x1008, 0x0808, 0x0008},	/* xRGB8888 */
+};
+
+/* default format is given by build option */
+#if defined(COLOR_CMAP256)
+#define	FMT_DEFAULT	0
+#elif defined(COLOR_RGB565)
+#define	FMT_DEFAULT	1
+#else
+#define	FMT_DEFAULT	2
+#endif
+
+EXPORT	CONST	VideoFormat	*VideoFmt = &VideoFormatTab[FMT_DEFAULT];
+
+LOCAL	void	selectFormat(W bpp)
+{
+	W	i;
+
+	if (bpp == 24) bpp = 32;	/* 24bpp is stored in 32bit */
+
+	for (i = 0; i < sizeof(VideoFormatTab) / sizeof(VideoFormat); i++) {
+		if (((VideoFormatTab[i].pixbits >> 8) & 0xff) == bpp) {
+			VideoFmt = &VideoFormatTab[i];
+			break;
+		}
+	}
+	return;
+}
+#endif
+
 /* definition of color map */
 EXPORT	UW	Cmap[256] = {
 	0x10ffffff, 0x1000009f, 0x1000ef00, 0x1000efef,
@@ -147,6 +209,119 @@ EXPORT	void*	getPhyMemory(W size, void **phyaddr)
 		CnvPhysicalAddr(la, size, phyaddr) < size) ? NULL : la;
 }
 #endif
+/*
+        obtain memory shared with user process (read only for user)
+*/
+EXPORT	void*	getSharedMemory(W size, void **uaddr)
+{
+	void	*la, *pa;
+
+	if (MapMemory(NULL, size, MM_SYSTEM | MM_READ | MM_WRITE, &la) < E_OK)
+		return NULL;
+
+	if (CnvPhysicalAddr(la, size, &pa) < size ||
+	    MapMemory(pa, size, MM_USER | MM_READ, uaddr) < E_OK) {
+		UnmapMemory(la);
+		return NULL;
+	}
+
+	return la;
+}
+/*
+        MTRR (memory type range register)
+*/
+#define	MSR_MTRRCAP		0x0fe
+#define	MSR_MTRRPHYSBASE(n)	(0x200 + (n) * 2)
+#define	MSR_MTRRPHYSMASK(n)	(0x201 + (n) * 2)
+
+#define	MTRRCAP_VCNT		0xff
+#define	MTRRCAP_WC		(1 << 10)
+#define	MTRR_TYPE_MASK		0xff
+#define	MTRR_TYPE_WC		0x01
+#define	MTRR_VALID		(1 << 11)
+
+#define	CPUID1_MTRR		(1 << 12)
+#define	CR0_NW			(1 << 29)
+#define	CR0_CD			(1 << 30)
+
+/*
+        set write-combining memory type to the physical address range
+                * range must be size-aligned power of 2
+                * range covered by another MTRR is not changed,
+                  UC (usually used for PCI memory hole) takes precedence
+*/
+LOCAL	ERR	setWCombine(void *paddr, W len)
+{
+	ERR	err;
+	W	i, n, free;
+	UW	a, b, c, d, cr0, imask;
+	UD	base, mask, pmask, rbase, rmask;
+
+        /* MTRR is available? */
+	cpuid(1, &a, &b, &c, &d);
+	if (!(d & CPUID1_MTRR) ||
+	    !(rdmsr(MSR_MTRRCAP) & MTRRCAP_WC)) {
+		err = ER_NOSPT;
+		goto fin0;
+	}
+	n = rdmsr(MSR_MTRRCAP) & MTRRCAP_VCNT;
+
+        /* physical address width */
+	cpuid(0x80000000, &a, &b, &c, &d);
+	if (a >= 0x80000008) {
+		cpuid(0x80000008, &a, &b, &c, &d);
+		pmask = ((UD)1 << (a & 0xff)) - 1;
+	} else {
+		pmask = ((UD)1 << 36) - 1;
+	}
+
+	base = (UW)paddr;
+	for (i = 1; i < len; i <<= 1);
+	if (base & (i - 1)) {
+		err = ER_PAR;
+		goto fin0;
+	}
+	mask = ~((UD)i - 1) & pmask;
+
+        /* look for free register, and check overlap */
+	for (free = -1, i = 0; i < n; i++) {
+		rmask = rdmsr(MSR_MTRRPHYSMASK(i));
+		if (!(rmask & MTRR_VALID)) {
+			if (free < 0) free = i;
+			continue;
+		}
+		rbase = rdmsr(MSR_MTRRPHYSBASE(i));
+		rmask &= pmask & ~(UD)0xfff;
+		if ((rbase & rmask & mask) != (base & rmask & mask)) continue;
+
+		err = ((rbase & MTRR_TYPE_MASK) == MTRR_TYPE_WC &&
+		       (rbase & ~(UD)0xfff & pmask) == base && rmask == mask) ?
+			ER_OK : ER_BUSY;
+		goto fin0;
+	}
+	if (free < 0) {
+		err = ER_LIMIT;
+		goto fin0;
+	}
+
+        /* update MTRR with cache disabled (Intel SDM 11.11.7.2) */
+	DI(imask);
+	cr0 = getCR0();
+	setCR0((cr0 | CR0_CD) & ~CR0_NW);
+	wbinvd();
+
+	wrmsr(MSR_MTRRPHYSBASE(free), base | MTRR_TYPE_WC);
+	wrmsr(MSR_MTRRPHYSMASK(free), mask | MTRR_VALID);
+
+	wbinvd();
+	flushTLB();
+	setCR0(cr0);
+	EI(imask);
+
+	err = ER_OK;
+fin0:
+	return err;
+}
 /*
         mapping framebuffer to logical address space
 */
@@ -157,8 +332,113 @@ EXPORT	ERR	mapFrameBuf(void *paddr, W len, void **laddr)
         /* user process can access this only when we do not use virtual VRAM */
 	attr = allowUserVRAM ? MM_USER : MM_SYSTEM;
 
-	return MapMemory(paddr, len,
-			attr | MM_READ | MM_WRITE | MM_CDIS, laddr);
+        /* write-combining: page is cacheable, memory type is set by MTRR
+                (whole FrameBuffer, so that growing mapping keeps it) */
+	if ((Vinf.attr & USE_WCOMBINE) &&
+	    setWCombine(paddr, Vinf.framebuf_total) < ER_OK) {
+		Vinf.attr &= ~USE_WCOMBINE;
+	}
+	if (!(Vinf.attr & USE_WCOMBINE)) attr |= MM_CDIS;
+
+	return MapMemory(paddr, len, attr | MM_READ | MM_WRITE, laddr);
+}
+/*
+        size of the largest usable display mode (modemap)
+*/
+LOCAL	W	maxModeSize(void)
+{
+	W	m, n, max;
+
+	max = 0;
+	for (m = 0; m < MAX_VIDEO_MODE; m++) {
+		if (!(Vinf.modemap & (1 << m))) continue;
+		n = VideoHsize(m) * VideoVsize(m) *
+			((VideoPixBits(m) >> 11) & 0x1f);
+		if (n > max) max = n;
+	}
+	return max;
+}
+/*
+        allocate virtual VRAM (cached, as large as the largest mode)
+                * allocated once after setModeMap(), the address does not
+                  change at mode change (DN_SCRBMP, flush task)
+*/
+EXPORT	ERR	allocVVRAM(void)
+{
+	ERR	err;
+	W	nblk;
+	M_STATE	sts;
+
+	err = b_mbk_sts(&sts);
+	if (err < ER_OK) goto fin0;
+	nblk = (maxModeSize() - 1) / sts.blksz + 1;
+
+	err = b_get_mbk(&Vinf.v_addr, nblk, M_SYSTEM | M_RESIDENT);
+	if (err < ER_OK) {
+		Vinf.v_addr = NULL;
+		goto fin0;
+	}
+	memset(Vinf.v_addr, 0, nblk * sts.blksz);
+	Vinf.v_size = nblk * sts.blksz;
+
+	err = ER_OK;
+fin0:
+	return err;
+}
+/*
+        map real VRAM, once after setModeMap()
+                * whole FrameBuffer is mapped: it takes no memory, and
+                  the address does not change for user mappings
+                  (allowUserVRAM), page flip and virtual screen
+                * without physical FrameBuffer (None), memory for the
+                  largest mode is not resident, so that pages are
+                  populated when touched
+*/
+EXPORT	ERR	allocFrameBuf(void)
+{
+	ERR	err;
+	W	nblk, size;
+	void	*p;
+	M_STATE	sts;
+
+	if (Vinf.framebuf_addr != NULL) {
+		size = Vinf.framebuf_total;
+		err = mapFrameBuf(Vinf.framebuf_addr, size, &p);
+		if (err < ER_OK) goto fin0;
+	} else {
+		err = b_mbk_sts(&sts);
+		if (err < ER_OK) goto fin0;
+		nblk = (maxModeSize() - 1) / sts.blksz + 1;
+		size = nblk * sts.blksz;
+
+		err = b_get_mbk(&p, nblk, M_SYSTEM);
+		if (err < ER_OK) goto fin0;
+	}
+
+	Vinf.f_addr = p;
+	Vinf.f_size = size;
+
+	err = ER_OK;
+fin0:
+	return err;
+}
+/*
+        check that memory holds the display mode, called after fn_setmode()
+*/
+LOCAL	ERR	fitMemory(void)
+{
+	W	n;
+
+        /* FrameBuffer, including page flip buffers */
+	n = Vinf.framebuf_rowb * Vinf.fb_height;
+	if (Vinf.flipbuf > 1) n *= Vinf.flipbuf;
+	if (n > Vinf.f_size) return ER_NOMEM;
+
+        /* separate virtual VRAM */
+	if (Vinf.v_addr != NULL && Vinf.v_addr != Vinf.f_addr &&
+	    Vinf.rowbytes * Vinf.fb_height > Vinf.v_size) return ER_NOMEM;
+
+	return ER_OK;
 }
 /*
         initialization
@@ -182,11 +462,14 @@ EXPORT	ERR	initSCREEN(void)
         /* default display mode */
 	n = 0;
 
-        /* requested display mode : VIDEOMODE */
-	v[2] = v[3] = 0;
+        /* requested display mode : VIDEOMODE mode bpp width height */
+	v[1] = v[2] = v[3] = 0;
 	if (GetDevConf("VIDEOMODE", v) > 0 && v[0] > 0) {
 		if (VALID_VIDEO_MODE(v[0] - 1)) n = v[0] - 1;
 	}
+#ifndef USE_DEVICE_VIDEOMODE_H
+	if (v[1] > 0) selectFormat(v[1]);
+#endif
 
 	Vinf.reqmode = n;
 
@@ -216,6 +499,14 @@ EXPORT	ERR	initSCREEN(void)
 	 * Vinf.fn_susres, Vinf.modemap
 	 */
 
+        /* select drawing routine for this CPU */
+	initDraw();
+	if (initCursor() < ER_OK) return ER_NOMEM;
+	if (CreateLockWN(&Fence.lock, "vmsf") < ER_OK) return ER_NOMEM;
+
+        /* scanout format : VIDEOSCANOUT */
+	initConvert(VideoPixBits(Vinf.reqmode));
+
         /* initialize according the needs of video board and chip */
 	for (i = 0; VideoFunc[i] != NULL &&
 	     (n = (*VideoFunc[i])()) == 0; i++);
@@ -226,6 +517,10 @@ EXPORT	ERR	initSCREEN(void)
 	Vinf.width      = Vinf.fb_width   = VideoHsize(Vinf.curmode);
 	Vinf.height     = Vinf.fb_height  = VideoVsize(Vinf.curmode);
 	Vinf.pixbits    = VideoPixBits(Vinf.curmode);
+	Vinf.pixbyte    = ((Vinf.pixbits >> 8) + 7) / 8;
+	if (Vinf.scanbits && VideoCmapEnt(Vinf.curmode) > 0) {
+		Vinf.fn_setcmap = convSetCmap;	/* palette is emulated */
+	}
 	Vinf.rowbytes   = Vinf.framebuf_rowb;
 	Vinf.vramsz     = Vinf.framebuf_rowb * Vinf.fb_height;
 	if (Vinf.framebuf_total > 0 &&
@@ -246,8 +541,15 @@ EXPORT	ERR	initSCREEN(void)
         /* configure actual video mode */
 	(*Vinf.fn_setmode)(1);
 
+        /* memory must hold the mode */
+	if (fitMemory() < ER_OK) return ER_NOMEM;
+
         /* set effective VRAM address */
-	Vinf.baseaddr = Vinf.f_addr;
+	Vinf.baseaddr = (Vinf.v_addr != NULL) ? Vinf.v_addr : Vinf.f_addr;
+
+        /* fit damage tracking to the screen, and pace it by VIDEOVFREQ */
+	resetDamage();
+	setDamageRate(Vinf.vfreq);
 
         /* set color map */
 	Vinf.cmapent = VideoCmapEnt(Vinf.curmode);
@@ -255,18 +557,95 @@ EXPORT	ERR	initSCREEN(void)
                 /* entry #0 (white) is yet to be set so that the screen can be totally dark */
 		(*Vinf.fn_setcmap)(Vinf.cmap + 1, 1, Vinf.cmapent - 1);
 
-		if (Vinf.v_addr == NULL) {	/* screen clear (black = 0xFF) */
-			memset(Vinf.baseaddr, 0xFF, Vinf.vramsz);
+		if (Vinf.v_addr == NULL || Vinf.v_addr == Vinf.f_addr) {
+                        /* FrameBuffer is drawn directly (VMware SVGA II FIFO updates it in place) */
+                        /* screen clear (black = 0xFF), entry #0 (white) is set after that */
+			startClear(0xFF);
 		} else {
                         /* update virtual VRAM screen(virtual VRAM has already been cleared) */
 			(*Vinf.fn_updscr)(0, 0, Vinf.width, Vinf.height);
+                        /* set entry #0 (white) */
+			(*Vinf.fn_setcmap)(Vinf.cmap, 0, 1);
 		}
-                /* set entry #0 (white) */
-		(*Vinf.fn_setcmap)(Vinf.cmap, 0, 1);
 	}
 
 	return ER_OK;
 }
+/*
+        select usable display modes and the initial one
+                * called by the individual driver after framebuf_total is set
+*/
+EXPORT	void	setModeMap(UW map, W defmode, W maxw, W maxh)
+{
+	W	m, w, h, n;
+
+	for (m = 0; m < MAX_VIDEO_MODE; m++) {
+		if (!(map & (1 << m)) || m == defmode) continue;
+
+                /* both virtual VRAM and scanout must fit */
+		n = (VideoPixBits(m) >> 11) & 0x1f;
+		if (n < ((Vinf.scanbits >> 11) & 0x1f))
+			n = (Vinf.scanbits >> 11) & 0x1f;
+
+		w = VideoHsize(m);
+		h = VideoVsize(m);
+		if ((maxw > 0 && w > maxw) || (maxh > 0 && h > maxh) ||
+		    w * n * h > Vinf.framebuf_total) map &= ~(1 << m);
+	}
+	Vinf.modemap = map | (1 << defmode);
+
+        /* use requested mode (VIDEOMODE) if available */
+	if (!(Vinf.modemap & (1 << Vinf.reqmode))) Vinf.reqmode = defmode;
+	Vinf.curmode = Vinf.reqmode;
+
+	return;
+}
+/*
+        change display mode while running
+                * only the size changes, pixel format (convert table, color
+                  map, scanout) is fixed at initialization
+*/
+LOCAL	ERR	changeSCRNO(W mode)
+{
+	W	rowb, old;
+
+	if (VideoPixBits(mode) != Vinf.pixbits) return ER_NOSPT;
+
+	rowb = VideoHsize(mode) * ((VideoPixBits(mode) >> 11) & 0x1f);
+	if (rowb * VideoVsize(mode) > Vinf.framebuf_total) return ER_NOMEM;
+
+        /* emit pending update of the old screen, and keep the flush task
+           away from the screen while it changes */
+	holdDamage();
+
+	old = Vinf.curmode;
+	Vinf.reqmode = Vinf.curmode = mode;
+	Vinf.width      = Vinf.fb_width   = Vinf.act_width  = VideoHsize(mode);
+	Vinf.height     = Vinf.fb_height  = Vinf.act_height = VideoVsize(mode);
+	Vinf.rowbytes   = Vinf.framebuf_rowb = rowb;
+	Vinf.vramsz     = Vinf.framebuf_rowb * Vinf.fb_height;
+
+        /* reprogram the hardware, this fixes rowbytes and vramsz */
+	(*Vinf.fn_setmode)(1);
+	Vinf.viewx = Vinf.viewy = 0;
+
+        /* go back if memory does not hold the mode */
+	if (fitMemory() < ER_OK) {
+		releaseDamage();
+		if (mode != old) changeSCRNO(old);
+		return ER_NOMEM;
+	}
+
+	Vinf.baseaddr = (Vinf.v_addr != NULL) ? Vinf.v_addr : Vinf.f_addr;
+	resetDamage();
+
+        /* screen clear (black = 0xFF when color map is used) */
+	memset(Vinf.baseaddr, (Vinf.cmapent > 0) ? 0xFF : 0, Vinf.vramsz);
+	releaseDamage();
+	if (Vinf.fn_updscr) (*Vinf.fn_updscr)(0, 0, Vinf.width, Vinf.height);
+
+	return ER_OK;
+}
 /*
         epilog processing
 */
@@ -306,8 +685,8 @@ EXPORT	ERR	getSCRXSPEC(DEV_SPEC *spec, W mode)
 
 	spec->planes = 1;
 	spec->pixbits = VideoPixBits(mode);
-	spec->hpixels = Vinf.act_width;
-	spec->vpixels = Vinf.act_height;
+	spec->hpixels = (mode == Vinf.curmode) ? Vinf.act_width : VideoHsize(mode);
+	spec->vpixels = (mode == Vinf.curmode) ? Vinf.act_height : VideoVsize(mode);
 	spec->hres = 0;
 	spec->vres = 0;
 	if (VideoCmapEnt(mode) > 0) {
@@ -450,21 +829,43 @@ EXPORT	W	getSCRLIST(TC *str)
 */
 EXPORT	ERR	getsetSCRNO(W *scnum, BOOL suspend, BOOL set)
 {
-	if (set) return ER_NOSPT;	/* mode is not supported */
-	*scnum = Vinf.curmode + 1;
-	return ER_OK;
+	W	mode;
+
+	if (!set) {
+		*scnum = Vinf.curmode + 1;
+		return ER_OK;
+	}
+
+	mode = *scnum - 1;
+	if (mode < 0 || mode >= MAX_VIDEO_MODE ||
+	    !(Vinf.modemap & (1 << mode))) return ER_PAR;
+	if (suspend) return ER_BUSY;	/* hardware is not available */
+	if (mode == Vinf.curmode) return ER_OK;
+
+	return changeSCRNO(mode);
 }
 /*
         get / set color map
 */
 EXPORT	WERR	getsetSCRCOLOR(COLOR *cmap, BOOL set)
 {
+	W	i, n;
+
 	if (Vinf.cmapent <= 0) return ER_OBJ;	/* colormap is not used */
 
 	if (cmap != NULL) {
 		if (set) {
-			memcpy(Vinf.cmap, cmap, Vinf.cmapent * sizeof(COLOR));
-			(*Vinf.fn_setcmap)(Vinf.cmap, 0, Vinf.cmapent);
+                        /* upload changed runs only */
+			for (i = 0; i < Vinf.cmapent; i += n) {
+				for (; i < Vinf.cmapent &&
+					     cmap[i] == Vinf.cmap[i]; i++);
+				for (n = 0; i + n < Vinf.cmapent &&
+					     cmap[i + n] != Vinf.cmap[i + n]; n++);
+				if (n <= 0) break;
+
+				memcpy(&Vinf.cmap[i], &cmap[i], n * sizeof(COLOR));
+				(*Vinf.fn_setcmap)(&Vinf.cmap[i], i, n);
+			}
 		} else {
 			memcpy(cmap, Vinf.cmap, Vinf.cmapent * sizeof(COLOR));
 		}
@@ -508,22 +909,108 @@ EXPORT	ERR	getSCRUPDFN(FP *updfn)
 EXPORT	ERR	setSCRUPDRECT(RECT *rp)
 {
 	if (! Vinf.fn_updscr) return ER_NOSPT;	/* not supported */
+	if (rp->c.left > rp->c.right || rp->c.top > rp->c.bottom) return ER_PAR;
 	(*Vinf.fn_updscr)(rp->c.left, rp->c.top, rp->c.right - rp->c.left,
 			rp->c.bottom - rp->c.top);
 	return ER_OK;
 }
+
+/*
+        present fence (DN_SCRFENCE)
+                * sequence number is mapped to device fence ID, slot
+                  reused by newer fence is still correct to wait for
+                  since device processes fences in order
+                * latency is counted once per fence, when it is first
+                  seen completed (not when, or how often, it is waited)
+*/
+LOCAL	void	reapFence(void)
+{
+	UW	i, now;
+
+	now = statClock();
+	while (Fence.done != Fence.seq) {
+		i = (Fence.done + 1) & (FENCE_HIST - 1);
+		if (Fence.id[i] && (*Vinf.fn_fencewait)(Fence.id[i], 0) < ER_OK)
+			break;
+		statFence(now - Fence.time[i]);
+		Fence.id[i] = 0;
+		Fence.done++;
+	}
+	return;
+}
+
+EXPORT	ERR	getSCRFENCE(ScrFence *fence)
+{
+	UW	id;
+
+	flushDamage();
+
+	Lock(&Fence.lock);
+	reapFence();
+
+	/* oldest slot is reused, its latency is not counted */
+	if (Fence.seq - Fence.done >= FENCE_HIST) Fence.done++;
+
+	id = (Vinf.fn_fence) ? (*Vinf.fn_fence)() : 0;
+	fence->seq = ++Fence.seq;
+	Fence.id[Fence.seq & (FENCE_HIST - 1)] = id;
+	Fence.time[Fence.seq & (FENCE_HIST - 1)] = statClock();
+	reapFence();
+	Unlock(&Fence.lock);
+
+	return ER_OK;
+}
+
+EXPORT	ERR	setSCRFENCE(ScrFenceWait *wait)
+{
+	ERR	err;
+	UW	id;
+
+	/* not issued yet */
+	if ((W)(wait->seq - Fence.seq) > 0) return ER_PAR;
+
+	Lock(&Fence.lock);
+	reapFence();
+	id = Fence.id[wait->seq & (FENCE_HIST - 1)];
+	Unlock(&Fence.lock);
+	if (!id) return ER_OK;
+
+	err = (*Vinf.fn_fencewait)(id, wait->tmout);
+	if (err >= ER_OK) {
+		Lock(&Fence.lock);
+		reapFence();
+		Unlock(&Fence.lock);
+	}
+
+	return err;
+}
+/*
+        emit queued screen updates, and wait for them (DN_SCRFLUSH)
+*/
+EXPORT	ERR	setSCRFLUSH(W mode)
+{
+	if (mode != FLUSH_EMIT && mode != FLUSH_WAIT) return ER_PAR;
+
+	flushDamage();
+	if (mode == FLUSH_WAIT && Vinf.fn_sync) return (*Vinf.fn_sync)();
+
+	return ER_OK;
+}
 /*
         get / set monitor vertical scan frequency
 */
 EXPORT	ERR	getsetSCRVFREQ(W *vfreq, BOOL set)
 {
-	if ((Vinf.attr & SUPPORT_VFREQ) == 0) return ER_NOSPT; /* not supported */
+        /* refresh rate of hardware, or present rate of virtual VRAM */
+	if ((Vinf.attr & SUPPORT_VFREQ) == 0 &&
+	    Vinf.fn_updscr != addDamage) return ER_NOSPT; /* not supported */
 
 	if (set) {
 		if ((Vinf.vfreq = *vfreq) <= 0)  Vinf.vfreq = 0;
 		else if (Vinf.vfreq < MIN_VFREQ) Vinf.vfreq = MIN_VFREQ;
 		else if (Vinf.vfreq > MAX_VFREQ) Vinf.vfreq = MAX_VFREQ;
-		(*Vinf.fn_setmode)(0);
+		if (Vinf.attr & SUPPORT_VFREQ) (*Vinf.fn_setmode)(0);
+		setDamageRate(Vinf.vfreq);
 	} else {
 		*vfreq = Vinf.vfreq;
 	}
@@ -546,17 +1033,143 @@ EXPORT	ERR	getSCRDEVINFO(ScrDevInfo *inf)
 	memcpy(inf->name1, Vinf.oemname, L_OEMNAME);
 	memcpy(inf->name3, Vinf.chipinf, L_CHIPINF);
 
+	strncpy(inf->name2, (Vinf.attr & USE_WCOMBINE) ?
+		"write-combining" : "uncached", L_CHIPINF);
+
 	inf->framebuf_addr = (Vinf.attr & BPP_24) ? NULL : Vinf.framebuf_addr;
 	inf->framebuf_size = Vinf.framebuf_total;
 	inf->mainmem_size  = (Vinf.v_addr != NULL) ? Vinf.vramsz : 0;
 
 	return ER_OK;
 }
+/*
+        get / set page flip
+*/
+EXPORT	ERR	getsetSCRFLIP(void *buf, BOOL set)
+{
+	ERR	err;
+	W	i, mode;
+	ScrFlip		*flip = buf;
+	ScrFlipInf	*inf = buf;
+
+	if (!Vinf.fn_flip || Vinf.flipbuf < 2) {
+		err = ER_NOSPT;		/* not supported */
+		goto fin0;
+	}
+
+	if (set) {
+		mode = flip->mode;
+		if (flip->buf < 0 || flip->buf >= Vinf.flipbuf ||
+		    mode < FLIP_IMMEDIATE || mode > FLIP_MAILBOX) {
+			err = ER_PAR;
+			goto fin0;
+		}
+
+		/* mailbox needs a buffer other than front and pending one */
+		if (mode == FLIP_MAILBOX && Vinf.flipbuf < 3) mode = FLIP_VSYNC;
+
+		err = (*Vinf.fn_flip)(flip->buf, mode);
+		if (err < ER_OK) goto fin0;
+
+		/* previous front buffer may be shown until next refresh */
+		Vinf.flipprev = (mode == FLIP_MAILBOX) ?
+			Vinf.flipfront : flip->buf;
+		Vinf.flipfront = flip->buf;
+	} else {
+		inf->nbuf = Vinf.flipbuf;
+		inf->front = Vinf.flipfront;
+		for (i = 0; i == Vinf.flipfront || i == Vinf.flipprev; i++);
+		inf->back = i;
+		for (i = 0; i < MAX_FLIPBUF; i++) {
+			inf->baseaddr[i] = (i < Vinf.flipbuf) ?
+				Vinf.baseaddr + Vinf.vramsz * i : NULL;
+		}
+	}
+
+	err = ER_OK;
+fin0:
+	return err;
+}
+/*
+        get / set viewport
+                * virtual screen is placed in FrameBuffer directly
+*/
+#define	VIEW_MAX	0xffff	/* virtual size register is 16 bits (DISPI) */
+
+EXPORT	ERR	getsetSCRVIEW(ScrView *view, BOOL set)
+{
+	ERR	err;
+	W	w, h, oldw, oldh;
+
+	if (!Vinf.fn_view || (Vinf.attr & USE_VVRAM)) {
+		err = ER_NOSPT;		/* not supported */
+		goto fin0;
+	}
+
+	if (!set) {
+		view->x = Vinf.viewx;
+		view->y = Vinf.viewy;
+		view->width = Vinf.width;
+		view->height = Vinf.height;
+		err = ER_OK;
+		goto fin0;
+	}
+
+	w = (view->width > 0) ? view->width : Vinf.width;
+	h = (view->height > 0) ? view->height : Vinf.height;
+	if (w < Vinf.act_width || h < Vinf.act_height ||
+	    w > VIEW_MAX || h > VIEW_MAX ||
+	    view->x < 0 || view->x > w - Vinf.act_width ||
+	    view->y < 0 || view->y > h - Vinf.act_height) {
+		err = ER_PAR;
+		goto fin0;
+	}
+	if (h > Vinf.framebuf_total / (w * Vinf.pixbyte)) {
+		err = ER_NOMEM;
+		goto fin0;
+	}
+
+        /* panning, only the offset is changed (page flip owns it if
+	   virtual screen is the visible size) */
+	if (w == Vinf.width && h == Vinf.height) {
+		if (w == Vinf.act_width && h == Vinf.act_height) goto fin1;
+		err = (*Vinf.fn_view)(0, 0, view->x, view->y);
+		if (err < ER_OK) goto fin0;
+		goto fin1;
+	}
+
+        /* virtual screen, this fixes width, rowbytes, vramsz, flipbuf */
+	oldw = Vinf.width;
+	oldh = Vinf.height;
+	err = (*Vinf.fn_view)(w, h, view->x, view->y);
+	if (err < ER_OK) goto fin0;
+
+	if (fitMemory() < ER_OK) {
+		(*Vinf.fn_view)(oldw, oldh, Vinf.viewx, Vinf.viewy);
+		err = ER_NOMEM;
+		goto fin0;
+	}
+	Vinf.baseaddr = Vinf.f_addr;
+
+        /* screen clear (black = 0xFF when color map is used) */
+	memset(Vinf.baseaddr, (Vinf.cmapent > 0) ? 0xFF : 0, Vinf.vramsz);
+	if (Vinf.fn_updscr) (*Vinf.fn_updscr)(0, 0, Vinf.width, Vinf.height);
+
+fin1:
+	Vinf.viewx = view->x;
+	Vinf.viewy = view->y;
+	err = ER_OK;
+fin0:
+	return err;
+}
 /*
         screen draw processing
 */
 EXPORT	ERR	setSCRWRITE(W kind, void *buf, W size)
 {
-	if (Vinf.fn_write) return (*Vinf.fn_write)(kind, buf, size);
-	return ER_NOSPT;		/* not supported */
+	ERR	err;
+
+	/* use CPU if the chip does not support it */
+	err = (Vinf.fn_write) ? (*Vinf.fn_write)(kind, buf, size) : ER_NOSPT;
+	return (err == ER_NOSPT) ? cpuSCRWRITE(kind, buf, size) : err;
 }
@@ -0,0 +1,249 @@
+/*
+	convert.c	screen driver
+	pixel format conversion from virtual VRAM to scanout
+
+	Copyright 2026 by agent
+	This software is distributed under the T-License 2.0.
+*/
+#include "screen.h"
+
+typedef UW	v4uw __attribute__((vector_size(16)));
+
+/* row conversion: n pixels from s to d, (x, y) is for dithering */
+typedef void	(*CONVROW)(UB *d, UB *s, W n, W x, W y);
+
+LOCAL	CONVROW	convRow;
+LOCAL	BOOL	Dither;
+
+/* palette (8bpp client) to scanout pixel */
+LOCAL	UW	Lut[256];
+
+/* ordered dithering threshold (4x4 Bayer matrix) */
+LOCAL	CONST	UB	Bayer[4][4] = {
+	{ 0,  8,  2, 10},
+	{12,  4, 14,  6},
+	{ 3, 11,  1,  9},
+	{15,  7, 13,  5},
+};
+
+#define	SAT8(v)		(((v) | (0 - ((v) >> 8))) & 0xff)
+
+Inline	UW	pack565(UW p, UW dr, UW dg)
+{
+	UW	r, g, b;
+
+	r = ((p >> 16) & 0xff) + dr;
+	g = ((p >>  8) & 0xff) + dg;
+	b = ((p >>  0) & 0xff) + dr;
+	return ((SAT8(r) & 0xf8) << 8) | ((SAT8(g) & 0xfc) << 3) |
+		(SAT8(b) >> 3);
+}
+
+/* 8bpp -> 16bpp / 32bpp: table lookup */
+LOCAL	void	conv8to16(UB *d, UB *s, W n, W x, W y)
+{
+	W	i;
+
+	for (i = 0; i < n; i++) ((UH *)d)[i] = Lut[s[i]];
+	return;
+}
+
+LOCAL	void	conv8to32(UB *d, UB *s, W n, W x, W y)
+{
+	W	i;
+
+	for (i = 0; i < n; i++) ((UW *)d)[i] = Lut[s[i]];
+	return;
+}
+
+/* 16bpp -> 32bpp */
+LOCAL	void	conv16to32(UB *d, UB *s, W n, W x, W y)
+{
+	W	i;
+
+	for (i = 0; i < n; i++) ((UW *)d)[i] = EXP565((UW)((UH *)s)[i]);
+	return;
+}
+
+__attribute__((target("sse2")))
+LOCAL	void	conv16to32SSE2(UB *d, UB *s, W n, W x, W y)
+{
+	v4uw	p, lo, hi, o0, o1;
+
+	/* 8 pixels per loop, UW holds 2 pixels */
+	for (; n >= 8; n -= 8, s += 16, d += 32) {
+		__builtin_memcpy(&p, s, sizeof(p));
+		lo = p & 0xffff;
+		hi = p >> 16;
+		lo = EXP565(lo);
+		hi = EXP565(hi);
+		o0 = __builtin_shuffle(lo, hi, ((v4uw){0, 4, 1, 5}));
+		o1 = __builtin_shuffle(lo, hi, ((v4uw){2, 6, 3, 7}));
+		__builtin_memcpy(d, &o0, sizeof(o0));
+		__builtin_memcpy(d + 16, &o1, sizeof(o1));
+	}
+	conv16to32(d, s, n, x, y);
+
+	return;
+}
+
+/* 32bpp -> 16bpp */
+LOCAL	void	conv32to16(UB *d, UB *s, W n, W x, W y)
+{
+	W	i;
+	UW	t;
+
+	for (i = 0; i < n; i++) {
+		t = Dither ? Bayer[y & 3][(x + i) & 3] : 0;
+		((UH *)d)[i] = pack565(((UW *)s)[i], t >> 1, t >> 2);
+	}
+	return;
+}
+
+__attribute__((target("sse2")))
+LOCAL	void	conv32to16SSE2(UB *d, UB *s, W n, W x, W y)
+{
+	W	i;
+	v4uw	p[2], c[2], r, g, b, dr, dg, o;
+
+	/* threshold of 4 pixels, the same for every 8 pixels */
+	for (i = 0; i < 4; i++) {
+		dr[i] = Dither ? Bayer[y & 3][(x + i) & 3] >> 1 : 0;
+		dg[i] = Dither ? Bayer[y & 3][(x + i) & 3] >> 2 : 0;
+	}
+
+	/* 8 pixels per loop */
+	for (; n >= 8; n -= 8, s += 32, d += 16, x += 8) {
+		__builtin_memcpy(p, s, sizeof(p));
+		for (i = 0; i < 2; i++) {
+			r = ((p[i] >> 16) & 0xff) + dr;
+			g = ((p[i] >>  8) & 0xff) + dg;
+			b = ((p[i] >>  0) & 0xff) + dr;
+			c[i] = ((SAT8(r) & 0xf8) << 8) |
+				((SAT8(g) & 0xfc) << 3) | (SAT8(b) >> 3);
+		}
+		o = __builtin_shuffle(c[0], c[1], ((v4uw){0, 2, 4, 6})) |
+			(__builtin_shuffle(c[0], c[1], ((v4uw){1, 3, 5, 7}))
+			 << 16);
+		__builtin_memcpy(d, &o, sizeof(o));
+	}
+	conv32to16(d, s, n, x, y);
+
+	return;
+}
+
+/*
+	convert updated region from virtual VRAM to FrameBuffer
+*/
+EXPORT	void	convRect(RECT *rp, W n)
+{
+	W	y, sofs, dofs, sbyte, dbyte, n0;
+
+	sbyte = Vinf.pixbyte;
+	dbyte = ScanByte;
+
+	for (n0 = n; n > 0; n--, rp++) {
+		sofs = rp->c.top * Vinf.rowbytes + rp->c.left * sbyte;
+		dofs = rp->c.top * Vinf.framebuf_rowb + rp->c.left * dbyte;
+		for (y = rp->c.top; y < rp->c.bottom; y++) {
+			(*convRow)(Vinf.f_addr + dofs, Vinf.v_addr + sofs,
+				   rp->c.right - rp->c.left, rp->c.left, y);
+			sofs += Vinf.rowbytes;
+			dofs += Vinf.framebuf_rowb;
+		}
+	}
+	drawCursor(rp - n0, n0);	/* on top of what was copied */
+	flushWC();
+
+	return;
+}
+
+/*
+	row to xRGB8888 for capture (DN_SCRCAPTURE), pb: bytes per pixel
+*/
+EXPORT	void	expandRow(UB *d, UB *s, W n, W pb)
+{
+	W	i;
+
+	switch (pb) {
+	case 1:
+		for (i = 0; i < n; i++)
+			((UW *)d)[i] = Vinf.cmap[s[i]] & 0x00ffffff;
+		break;
+	case 2:
+		if (CpuSIMD >= SIMD_SSE2) conv16to32SSE2(d, s, n, 0, 0);
+		else conv16to32(d, s, n, 0, 0);
+		break;
+	case 3:
+		for (i = 0; i < n; i++, s += 3)
+			((UW *)d)[i] = s[0] | (s[1] << 8) | (s[2] << 16);
+		break;
+	default:
+		memcpy(d, s, n * sizeof(UW));
+		break;
+	}
+
+	return;
+}
+
+/*
+	set color map of 8bpp client, used instead of fn_setcmap
+*/
+EXPORT	void	convSetCmap(COLOR *cmap, W index, W entries)
+{
+	W	i;
+	UW	p;
+
+	for (i = index; i < index + entries; i++, cmap++) {
+		p = *cmap & 0x00ffffff;
+		Lut[i] = (ScanByte == 2) ? pack565(p, 0, 0) : p;
+	}
+
+	/* every pixel may be changed */
+	if (Vinf.fn_updscr) (*Vinf.fn_updscr)(0, 0, Vinf.width, Vinf.height);
+
+	return;
+}
+
+/*
+	initialization
+		* VIDEOSCANOUT: bpp(8/16/32) dither(0/1)
+		* scanout format differs only with virtual VRAM, backend
+		  clears Vinf.scanbits if it does not support conversion
+*/
+EXPORT	ERR	initConvert(W pixbits)
+{
+	ERR	err;
+	W	src, dst, v[L_DEVCONF_VAL];
+
+	Vinf.scanbits = 0;
+	convRow = NULL;
+	Dither = FALSE;
+
+	if ((err = GetDevConf("VIDEOSCANOUT", v)) <= 0) goto fin1;
+	Dither = (err > 1 && v[1] > 0);
+
+	src = (pixbits >> 8) & 0xff;
+	dst = v[0];
+	if (src == dst) goto fin1;
+
+	if (src == 8 && dst == 16) {
+		convRow = conv8to16;
+	} else if (src == 8 && dst == 32) {
+		convRow = conv8to32;
+	} else if (src == 16 && dst == 32) {
+		convRow = (CpuSIMD >= SIMD_SSE2) ? conv16to32SSE2 : conv16to32;
+	} else if (src == 32 && dst == 16) {
+		convRow = (CpuSIMD >= SIMD_SSE2) ? conv32to16SSE2 : conv32to16;
+	} else {
+		err = ER_NOSPT;		/* no palette reduction */
+		goto fin0;
+	}
+
+	Vinf.scanbits = (dst == 32) ? 0x2018 : 0x1010;
+	Vinf.attr |= USE_VVRAM;
+fin1:
+	err = ER_OK;
+fin0:
+	return err;
+}
@@ -0,0 +1,76 @@
+/*
+	cpu.h		screen driver
+	privileged CPU operations (control registers, MSR, cache)
+
+		* host harness (SCREEN_HOST) can not execute them, it
+		  supplies the same functions (host/cpu.c)
+
+	Copyright 2026 by agent
+	This software is distributed under the T-License 2.0.
+*/
+
+#ifdef SCREEN_HOST
+IMPORT	UD	rdmsr(UW msr);
+IMPORT	void	wrmsr(UW msr, UD val);
+IMPORT	UW	getCR0(void);
+IMPORT	void	setCR0(UW cr0);
+IMPORT	UW	getCR4(void);
+IMPORT	void	wbinvd(void);
+IMPORT	void	flushTLB(void);
+IMPORT	void	drainWC(void);
+
+#else
+Inline	UD	rdmsr(UW msr)
+{
+	UW	lo, hi;
+
+	__asm__ __volatile__ ("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+	return ((UD)hi << 32) | lo;
+}
+
+Inline	void	wrmsr(UW msr, UD val)
+{
+	__asm__ __volatile__ ("wrmsr"
+			      : : "c"(msr), "a"((UW)val), "d"((UW)(val >> 32)));
+}
+
+Inline	UW	getCR0(void)
+{
+	UW	cr0;
+
+	__asm__ __volatile__ ("movl %%cr0, %0" : "=r"(cr0));
+	return cr0;
+}
+
+Inline	void	setCR0(UW cr0)
+{
+	__asm__ __volatile__ ("movl %0, %%cr0" : : "r"(cr0) : "memory");
+}
+
+Inline	UW	getCR4(void)
+{
+	UW	cr4;
+
+	__asm__ __volatile__ ("movl %%cr4, %0" : "=r"(cr4));
+	return cr4;
+}
+
+/* write back and invalidate caches */
+Inline	void	wbinvd(void)
+{
+	__asm__ __volatile__ ("wbinvd" : : : "memory");
+}
+
+/* reload CR3 */
+Inline	void	flushTLB(void)
+{
+	__asm__ __volatile__ ("movl %%cr3, %%eax; movl %%eax, %%cr3"
+			      : : : "eax", "memory");
+}
+
+/* locked instruction drains WC buffers, no SSE required */
+Inline	void	drainWC(void)
+{
+	__asm__ __volatile__ ("lock; addl $0, (%%esp)" : : : "memory");
+}
+#endif
@@ -0,0 +1,291 @@
+/*
+	cursor.c	screen driver
+	mouse cursor (DN_SCRCURSOR), software cursor if chip has none
+
+	Copyright 2026 by agent
+	This software is distributed under the T-License 2.0.
+*/
+#include "screen.h"
+
+/*
+	software cursor is composed into FrameBuffer at flush, virtual VRAM
+	keeps what is under the cursor
+		* without separate virtual VRAM there is no flush stage:
+		  client draws into the VRAM shown, pixels under a cursor
+		  drawn there would be stale, so it is not supported
+*/
+struct _curinf {
+	FastLock	lock;
+	BOOL		hw;		/* chip draws the cursor */
+	BOOL		defined;
+	BOOL		visible;
+	W		x, y;		/* hotspot position */
+	W		w, h;
+	W		hotx, hoty;
+	UW		image[CURSOR_MAX * CURSOR_MAX];	/* ARGB */
+	UB		index[CURSOR_MAX * CURSOR_MAX];	/* 8bpp color */
+};
+
+LOCAL	struct _curinf	Cur;
+
+/* software cursor is available */
+#define	composeMode	(Vinf.v_addr != NULL && Vinf.v_addr != Vinf.f_addr)
+
+/* blend premultiplied ARGB s onto xRGB d */
+Inline	UW	blend32(UW d, UW s)
+{
+	UW	a, rb, g;
+
+	a = 255 - (s >> 24);
+	rb = (((d & 0xff00ff) * a) >> 8) & 0xff00ff;
+	g = (((d & 0x00ff00) * a) >> 8) & 0x00ff00;
+
+	return (s + rb + g) & 0xffffff;
+}
+
+Inline	UH	pack565(UW p)
+{
+	return ((p >> 8) & 0xf800) | ((p >> 5) & 0x07e0) | ((p >> 3) & 0x001f);
+}
+
+/* color map entry nearest to s (alpha is removed) */
+LOCAL	UB	nearestColor(UW s)
+{
+	W	i, best, a, r, g, b, dr, dg, db, d, dmin;
+
+	a = s >> 24;
+	r = ((s >> 16) & 0xff) * 255 / a;
+	g = ((s >>  8) & 0xff) * 255 / a;
+	b = ((s >>  0) & 0xff) * 255 / a;
+
+	best = 0;
+	dmin = 0x7fffffff;
+	for (i = 0; i < Vinf.cmapent; i++) {
+		dr = ((Vinf.cmap[i] >> 16) & 0xff) - r;
+		dg = ((Vinf.cmap[i] >>  8) & 0xff) - g;
+		db = ((Vinf.cmap[i] >>  0) & 0xff) - b;
+		d = dr * dr + dg * dg + db * db;
+		if (d < dmin) {
+			dmin = d;
+			best = i;
+		}
+	}
+
+	return best;
+}
+
+/* cursor rectangle on screen, FALSE if nothing is visible */
+LOCAL	BOOL	cursorRect(RECT *r)
+{
+	r->c.left = Cur.x - Cur.hotx;
+	r->c.top = Cur.y - Cur.hoty;
+	r->c.right = r->c.left + Cur.w;
+	r->c.bottom = r->c.top + Cur.h;
+
+	if (r->c.left < 0) r->c.left = 0;
+	if (r->c.top < 0) r->c.top = 0;
+	if (r->c.right > Vinf.width) r->c.right = Vinf.width;
+	if (r->c.bottom > Vinf.height) r->c.bottom = Vinf.height;
+
+	return (Cur.defined && Cur.visible &&
+		r->c.left < r->c.right && r->c.top < r->c.bottom);
+}
+
+/* draw cursor clipped by clip into FrameBuffer */
+LOCAL	void	compose(UB *base, W rowb, W pb, RECT *clip)
+{
+	W	x, y, x0, y0, x1, y1, i;
+	UW	s;
+	UB	*p;
+	RECT	r;
+
+	if (!cursorRect(&r)) return;
+
+	x0 = (r.c.left > clip->c.left) ? r.c.left : clip->c.left;
+	y0 = (r.c.top > clip->c.top) ? r.c.top : clip->c.top;
+	x1 = (r.c.right < clip->c.right) ? r.c.right : clip->c.right;
+	y1 = (r.c.bottom < clip->c.bottom) ? r.c.bottom : clip->c.bottom;
+
+	for (y = y0; y < y1; y++) {
+		p = base + y * rowb + x0 * pb;
+		i = (y - (Cur.y - Cur.hoty)) * Cur.w + x0 - (Cur.x - Cur.hotx);
+		for (x = x0; x < x1; x++, p += pb, i++) {
+			if ((s = Cur.image[i]) < 0x01000000) continue;
+
+			switch (pb) {
+			case 4:
+				*(UW *)p = blend32(*(UW *)p, s);
+				break;
+			case 2:
+				s = blend32(EXP565((UW)*(UH *)p), s);
+				*(UH *)p = pack565(s);
+				break;
+			default:
+				if (s >= 0x80000000) *p = Cur.index[i];
+				break;
+			}
+		}
+	}
+
+	return;
+}
+
+Inline	void	updateRect(RECT *r)
+{
+	if (Vinf.fn_updscr && r->c.left < r->c.right && r->c.top < r->c.bottom)
+		(*Vinf.fn_updscr)(r->c.left, r->c.top,
+				  r->c.right - r->c.left,
+				  r->c.bottom - r->c.top);
+	return;
+}
+
+/* change software cursor, shape may be NULL */
+LOCAL	void	swCursor(ScrCurShape *shape, W x, W y, BOOL visible)
+{
+	W	i;
+	RECT	old, new;
+
+	Lock(&Cur.lock);
+
+	if (!cursorRect(&old)) old.c.right = old.c.left;
+
+	if (shape != NULL) {
+		Cur.w = shape->w;
+		Cur.h = shape->h;
+		Cur.hotx = shape->hotx;
+		Cur.hoty = shape->hoty;
+		memcpy(Cur.image, shape + 1, Cur.w * Cur.h * sizeof(UW));
+		if (Vinf.cmapent > 0) {
+			for (i = 0; i < Cur.w * Cur.h; i++) {
+				if (Cur.image[i] >= 0x80000000)
+					Cur.index[i] =
+						nearestColor(Cur.image[i]);
+			}
+		}
+		Cur.defined = TRUE;
+	}
+	Cur.x = x;
+	Cur.y = y;
+	Cur.visible = visible;
+
+	if (!cursorRect(&new)) new.c.right = new.c.left;
+
+	Unlock(&Cur.lock);
+
+	/* composed again at flush */
+	updateRect(&old);
+	updateRect(&new);
+
+	return;
+}
+
+/*
+	compose cursor into FrameBuffer, called by flush after it copied
+	virtual VRAM (the rectangles are in FrameBuffer format)
+*/
+EXPORT	void	drawCursor(RECT *rp, W n)
+{
+	if (Cur.hw || !Cur.defined || !Cur.visible) return;
+
+	Lock(&Cur.lock);
+	for (; n > 0; n--, rp++)
+		compose(Vinf.f_addr, Vinf.framebuf_rowb, ScanByte, rp);
+	Unlock(&Cur.lock);
+
+	return;
+}
+
+/* position of hardware cursor */
+LOCAL	ERR	hwMove(W x, W y, BOOL visible)
+{
+	ScrCurPos	pos;
+
+	pos.kind = SCRCUR_MOVE;
+	pos.x = x;
+	pos.y = y;
+	pos.visible = visible;
+	return (*Vinf.fn_cursor)(SCRCUR_MOVE, &pos, sizeof(pos));
+}
+
+/*
+	mouse cursor (DN_SCRCURSOR)
+*/
+EXPORT	ERR	setSCRCURSOR(W kind, void *buf, W size)
+{
+	ERR	err;
+	BOOL	visible;
+	ScrCurShape	*shape = buf;
+	ScrCurPos	*pos = buf;
+
+	switch (kind) {
+	case SCRCUR_SHAPE:
+		if (size < sizeof(ScrCurShape) ||
+		    shape->w <= 0 || shape->w > CURSOR_MAX ||
+		    shape->h <= 0 || shape->h > CURSOR_MAX ||
+		    shape->hotx < 0 || shape->hotx >= shape->w ||
+		    shape->hoty < 0 || shape->hoty >= shape->h ||
+		    size < (W)(sizeof(ScrCurShape) +
+			       shape->w * shape->h * sizeof(UW))) {
+			err = ER_PAR;
+			goto fin0;
+		}
+		break;
+	case SCRCUR_MOVE:
+		if (size < sizeof(ScrCurPos)) {
+			err = ER_PAR;
+			goto fin0;
+		}
+		break;
+	default:
+		err = ER_PAR;
+		goto fin0;
+	}
+
+	/* chip draws the cursor, if it has taken the shape */
+	err = (Vinf.fn_cursor && (kind == SCRCUR_SHAPE || Cur.hw)) ?
+		(*Vinf.fn_cursor)(kind, buf, size) : ER_NOSPT;
+	if (err != ER_NOSPT) {
+		if (err < ER_OK) goto fin0;
+
+		if (kind == SCRCUR_MOVE) {
+			Cur.x = pos->x;
+			Cur.y = pos->y;
+			Cur.visible = (pos->visible != 0);
+		} else if (!Cur.hw) {
+			/* remove software cursor, chip shows it instead */
+			visible = Cur.visible;
+			swCursor(NULL, Cur.x, Cur.y, FALSE);
+			Cur.visible = visible;
+			Cur.hw = TRUE;
+			err = hwMove(Cur.x, Cur.y, visible);
+		}
+		goto fin0;
+	}
+
+	/* no flush stage, or pixel format software cursor can not draw */
+	if (!composeMode || ScanByte == 3) goto fin0;
+
+	if (kind == SCRCUR_SHAPE) {
+		/* chip can not show this shape, hide the one it has */
+		if (Cur.hw) {
+			hwMove(Cur.x, Cur.y, FALSE);
+			Cur.hw = FALSE;
+		}
+		swCursor(shape, Cur.x, Cur.y, Cur.visible);
+	} else {
+		swCursor(NULL, pos->x, pos->y, pos->visible != 0);
+	}
+
+	err = ER_OK;
+fin0:
+	return err;
+}
+
+/*
+	initialization
+*/
+EXPORT	ERR	initCursor(void)
+{
+	memset(&Cur, 0, sizeof(Cur));
+	return CreateLockWN(&Cur.lock, "vmsu");
+}
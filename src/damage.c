@@ -0,0 +1,640 @@
+/*
+	damage.c	screen driver
+	accumulation of screen update (damaged) region
+
+	Copyright 2026 by agent
+	This software is distributed under the T-License 2.0.
+*/
+#include "screen.h"
+
+#define	DMG_SLOT	16	/* number of pending rectangles */
+#define	DMG_QUEUE	256	/* submission queue (power of 2) */
+
+#define	TILE_COL	32	/* tile columns (bits of UW) */
+#define	TILE_ROW	DMG_TILEROW	/* maximum tile rows */
+#define	TILE_WMIN	64	/* minimum tile width (pixel) */
+#define	TILE_H		16	/* tile height (pixel) */
+
+#define	DMG_FULL	50	/* full screen update threshold (%) */
+#define	DMG_GAP		16	/* merge distance (pixel) */
+#define	DMG_DELAY	10	/* coalescing delay (msec) */
+
+#define	TASK_EXINF	((void *)CH4toW('v', 'm', 's', 'd'))
+#define	TASK_STKSZ	4096
+
+/* submission queue entry, seq tells who owns it */
+struct _dmgq {
+	volatile UW	seq;
+	RECT		r;
+};
+
+struct _dmginf {
+	FastLock	lock;		/* consumer (merge / flush) side */
+	FastLock	flock;		/* held while the region is emitted */
+	ID		tskid;
+	ID		cycid;		/* present pacing (0: not paced) */
+
+	/* lock-free submission queue (multi-producer, single consumer) */
+	struct _dmgq	queue[DMG_QUEUE];
+	volatile UW	qtail;		/* next position to reserve */
+	UW		qhead;		/* next position to consume */
+	volatile UW	pending;	/* submissions since last drain */
+	volatile BOOL	overflow;	/* queue was full, update all */
+
+	W		mode;		/* DMG_RECT, DMG_TILE */
+	W		basemode;	/* mode requested by backend */
+	W		nrect;
+	BOOL		fullscr;
+	RECT		rect[DMG_SLOT];
+
+	/* dirty tile map, a row of tiles is one UW */
+	W		tilew;
+	W		tileh;
+	UW		tile[TILE_ROW];
+	UW		changed[TILE_ROW];	/* since last capture */
+
+	W		full;		/* threshold (percentage of screen) */
+	W		gap;		/* rectangles nearer than this are merged */
+	W		delay;		/* wait before flush */
+
+	/* backend: emit update for the rectangles */
+	void		(*fn_flush)(RECT *rp, W n);
+};
+
+LOCAL	struct _dmginf	Dmg;
+
+/* x86 does not reorder stores, only the compiler has to be stopped */
+#define	barrier()	__asm__ __volatile__ ("" : : : "memory")
+
+#define	rectArea(r)	(((r)->c.right - (r)->c.left) * \
+			 ((r)->c.bottom - (r)->c.top))
+
+/* TRUE if two rectangles overlap, touch or nearly touch */
+Inline	BOOL	rectNear(RECT *a, RECT *b, W gap)
+{
+	return (a->c.left <= b->c.right + gap &&
+		b->c.left <= a->c.right + gap &&
+		a->c.top <= b->c.bottom + gap &&
+		b->c.top <= a->c.bottom + gap);
+}
+
+Inline	void	rectUnion(RECT *d, RECT *s)
+{
+	if (d->c.left > s->c.left) d->c.left = s->c.left;
+	if (d->c.top > s->c.top) d->c.top = s->c.top;
+	if (d->c.right < s->c.right) d->c.right = s->c.right;
+	if (d->c.bottom < s->c.bottom) d->c.bottom = s->c.bottom;
+	return;
+}
+
+/* remove slot #i (order is not preserved) */
+Inline	void	removeSlot(W i)
+{
+	Dmg.rect[i] = Dmg.rect[--Dmg.nrect];
+	return;
+}
+
+/* merge r into the pending rectangles, then store it */
+LOCAL	void	mergeRect(RECT *r)
+{
+	W	i, k, area, grow, min;
+	RECT	u;
+
+ retry:
+	for (i = 0; i < Dmg.nrect; i++) {
+		if (rectNear(r, &Dmg.rect[i], Dmg.gap)) {
+			rectUnion(r, &Dmg.rect[i]);
+			removeSlot(i);
+			goto retry;	/* grown rectangle may reach others */
+		}
+	}
+
+	/* no free slot, merge with the one that grows least */
+	if (Dmg.nrect >= DMG_SLOT) {
+		min = 0x7fffffff;
+		for (i = k = 0; i < Dmg.nrect; i++) {
+			u = *r;
+			rectUnion(&u, &Dmg.rect[i]);
+			grow = rectArea(&u) - rectArea(&Dmg.rect[i]);
+			if (grow < min) {
+				min = grow;
+				k = i;
+			}
+		}
+		rectUnion(r, &Dmg.rect[k]);
+		removeSlot(k);
+		goto retry;
+	}
+
+	Dmg.rect[Dmg.nrect++] = *r;
+
+	/* too large, fall back to full screen update */
+	for (i = area = 0; i < Dmg.nrect; i++) area += rectArea(&Dmg.rect[i]);
+	if (area >= (Vinf.width * Vinf.height / 100) * Dmg.full) {
+		Dmg.fullscr = TRUE;
+		Dmg.nrect = 0;
+	}
+
+	return;
+}
+
+/* mark tiles covering r */
+LOCAL	void	markTile(UW *tile, RECT *r)
+{
+	W	y, y1;
+	UW	mask;
+
+	mask = (0xffffffff >> (TILE_COL - 1 - (r->c.right - 1) / Dmg.tilew)) &
+		(0xffffffff << (r->c.left / Dmg.tilew));
+	y1 = (r->c.bottom - 1) / Dmg.tileh;
+	for (y = r->c.top / Dmg.tileh; y <= y1; y++) tile[y] |= mask;
+
+	return;
+}
+
+/* convert dirty tiles to rectangles and flush them */
+LOCAL	void	flushTile(UW *tile)
+{
+	W	y, y0, n, rows, c, c0;
+	UW	mask;
+	RECT	r[DMG_SLOT];
+
+	rows = (Vinf.height + Dmg.tileh - 1) / Dmg.tileh;
+
+	for (n = y0 = 0; y0 < rows; y0 = y) {
+		/* rows having the same tile pattern are merged */
+		mask = tile[y0];
+		for (y = y0 + 1; y < rows && tile[y] == mask; y++);
+		if (!mask) continue;
+
+		/* each run of dirty tiles is one rectangle */
+		for (c = 0; c < TILE_COL; c++) {
+			if (!(mask & (1U << c))) continue;
+			for (c0 = c; c < TILE_COL && (mask & (1U << c)); c++);
+
+			r[n].c.left = c0 * Dmg.tilew;
+			r[n].c.right = c * Dmg.tilew;
+			r[n].c.top = y0 * Dmg.tileh;
+			r[n].c.bottom = y * Dmg.tileh;
+			if (r[n].c.right > Vinf.width)
+				r[n].c.right = Vinf.width;
+			if (r[n].c.bottom > Vinf.height)
+				r[n].c.bottom = Vinf.height;
+
+			if (++n >= DMG_SLOT) {
+				(*Dmg.fn_flush)(r, n);
+				n = 0;
+			}
+		}
+	}
+	if (n > 0) (*Dmg.fn_flush)(r, n);
+
+	return;
+}
+
+/* put r to submission queue, FALSE if full (never blocks) */
+LOCAL	BOOL	enqueue(RECT *r)
+{
+	UW	pos;
+	W	dif;
+	struct _dmgq	*q;
+
+	pos = Dmg.qtail;
+	while (1) {
+		q = &Dmg.queue[pos & (DMG_QUEUE - 1)];
+		dif = q->seq - pos;
+		if (dif < 0) return FALSE;	/* not consumed yet */
+		if (dif == 0 &&
+		    __sync_bool_compare_and_swap(&Dmg.qtail, pos, pos + 1))
+			break;
+		pos = Dmg.qtail;		/* another task took it */
+	}
+
+	q->r = *r;
+	barrier();
+	q->seq = pos + 1;			/* publish */
+
+	return TRUE;
+}
+
+/* move submitted rectangles to pending region, Dmg.lock is required */
+LOCAL	void	drainQueue(BOOL discard)
+{
+	RECT	r;
+	struct _dmgq	*q;
+
+	while (1) {
+		q = &Dmg.queue[Dmg.qhead & (DMG_QUEUE - 1)];
+		if (q->seq != Dmg.qhead + 1) break;	/* empty or writing */
+		r = q->r;
+		barrier();
+		q->seq = Dmg.qhead + DMG_QUEUE;		/* release */
+		Dmg.qhead++;
+
+		if (discard) continue;
+		markTile(Dmg.changed, &r);
+		if (Dmg.mode == DMG_TILE) {
+			markTile(Dmg.tile, &r);
+			Dmg.nrect = 1;		/* something is pending */
+		} else if (!Dmg.fullscr) {
+			mergeRect(&r);
+		}
+	}
+
+	/* some rectangles are lost, update whole screen */
+	if (__sync_lock_test_and_set(&Dmg.overflow, FALSE) && !discard) {
+		memset(Dmg.changed, 0xff, sizeof(Dmg.changed));
+		if (Dmg.mode == DMG_TILE) {
+			r.c.left = r.c.top = 0;
+			r.c.right = Vinf.width;
+			r.c.bottom = Vinf.height;
+			markTile(Dmg.tile, &r);
+			Dmg.nrect = 1;
+		} else {
+			Dmg.fullscr = TRUE;
+			Dmg.nrect = 0;
+		}
+	}
+
+	return;
+}
+
+/*
+	add update region (same interface as fn_updscr)
+		* called by any task, does not block
+*/
+EXPORT	void	addDamage(W x, W y, W dx, W dy)
+{
+	RECT	r;
+
+	STAT_INC(updscr);
+
+	/* clip */
+	if (x < 0) {
+		dx += x;
+		x = 0;
+	}
+	if (y < 0) {
+		dy += y;
+		y = 0;
+	}
+	if (x + dx > Vinf.width) dx = Vinf.width - x;
+	if (y + dy > Vinf.height) dy = Vinf.height - y;
+	if (dx <= 0 || dy <= 0) goto fin0;
+
+	r.c.left = x;
+	r.c.top = y;
+	r.c.right = x + dx;
+	r.c.bottom = y + dy;
+
+	if (!enqueue(&r)) Dmg.overflow = TRUE;
+
+	/* first damage after drain, start coalescing period */
+	if (__sync_fetch_and_add(&Dmg.pending, 1) == 0 && !Dmg.cycid)
+		wup_tsk(Dmg.tskid);
+fin0:
+	return;
+}
+
+/*
+	emit pending update region, flock is held
+*/
+LOCAL	void	emitDamage(void)
+{
+	W	n, mode;
+	RECT	r[DMG_SLOT];
+	UW	tile[TILE_ROW];
+
+	Lock(&Dmg.lock);
+	Dmg.pending = 0;
+	__sync_synchronize();
+	drainQueue(FALSE);
+
+	if (Dmg.mode == DMG_TILE) {
+		n = Dmg.nrect;
+		if (n > 0) {
+			memcpy(tile, Dmg.tile, sizeof(tile));
+			memset(Dmg.tile, 0, sizeof(Dmg.tile));
+		}
+	} else if (Dmg.fullscr) {
+		r[0].c.left = r[0].c.top = 0;
+		r[0].c.right = Vinf.width;
+		r[0].c.bottom = Vinf.height;
+		n = 1;
+	} else {
+		n = Dmg.nrect;
+		memcpy(r, Dmg.rect, sizeof(RECT) * n);
+	}
+	mode = Dmg.mode;
+	Dmg.fullscr = FALSE;
+	Dmg.nrect = 0;
+	Unlock(&Dmg.lock);
+
+	if (n > 0) {
+		if (mode == DMG_TILE) {
+			flushTile(tile);
+		} else {
+			(*Dmg.fn_flush)(r, n);
+		}
+	}
+	return;
+}
+
+/*
+	emit pending update region
+		* flushes are serialized: when this returns, region added
+		  before the call has been passed to the backend, even if
+		  the flush task had already taken it
+*/
+EXPORT	void	flushDamage(void)
+{
+	if (Dmg.fn_flush == NULL) return;
+
+	Lock(&Dmg.flock);
+	emitDamage();
+	Unlock(&Dmg.flock);
+	return;
+}
+
+/*
+	emit pending update region and keep the backend idle until
+	releaseDamage(), while geometry or memory of the screen changes
+		* region added meanwhile is queued, flushDamage() waits
+*/
+EXPORT	void	holdDamage(void)
+{
+	if (Dmg.fn_flush == NULL) return;
+
+	Lock(&Dmg.flock);
+	emitDamage();
+	return;
+}
+
+EXPORT	void	releaseDamage(void)
+{
+	if (Dmg.fn_flush == NULL) return;
+
+	Unlock(&Dmg.flock);
+	return;
+}
+
+/*
+	discard pending update region, and fit tiles to the screen size
+*/
+EXPORT	void	resetDamage(void)
+{
+	if (Dmg.fn_flush == NULL) goto fin0;
+
+	Lock(&Dmg.lock);
+	drainQueue(TRUE);
+	Dmg.fullscr = FALSE;
+	Dmg.nrect = 0;
+	memset(Dmg.tile, 0, sizeof(Dmg.tile));
+
+	Dmg.tilew = (Vinf.width + TILE_COL - 1) / TILE_COL;
+	if (Dmg.tilew < TILE_WMIN) Dmg.tilew = TILE_WMIN;
+	Dmg.tileh = (Vinf.height + TILE_ROW - 1) / TILE_ROW;
+	if (Dmg.tileh < TILE_H) Dmg.tileh = TILE_H;
+
+	/* tiles are resized, all is changed for capture */
+	memset(Dmg.changed, 0xff, sizeof(Dmg.changed));
+	Unlock(&Dmg.lock);
+fin0:
+	return;
+}
+
+/*
+	take tiles changed since the last call (DN_SCRCAPTURE)
+		* tile has DMG_TILEROW entries, FALSE if damage is not tracked
+		* only tiles r covers are cleared, the rest is still changed
+		  for capture of another region
+*/
+EXPORT	BOOL	takeChanged(RECT *r, UW *tile, W *tilew, W *tileh)
+{
+	W	y, x0, y0, x1, y1;
+	UW	mask;
+
+	if (Dmg.fn_flush == NULL) return FALSE;
+
+	Lock(&Dmg.lock);
+	drainQueue(FALSE);
+	memcpy(tile, Dmg.changed, sizeof(Dmg.changed));
+
+	/* tiles inside r, the edge of screen ends the last tile */
+	x0 = (r->c.left + Dmg.tilew - 1) / Dmg.tilew;
+	y0 = (r->c.top + Dmg.tileh - 1) / Dmg.tileh;
+	x1 = (r->c.right >= Vinf.width) ? TILE_COL : r->c.right / Dmg.tilew;
+	y1 = (r->c.bottom >= Vinf.height) ? TILE_ROW :
+					    r->c.bottom / Dmg.tileh;
+	if (x0 < x1) {
+		mask = (x1 - x0 >= TILE_COL) ? ~0U :
+			((1U << (x1 - x0)) - 1) << x0;
+		for (y = y0; y < y1; y++) Dmg.changed[y] &= ~mask;
+	}
+	*tilew = Dmg.tilew;
+	*tileh = Dmg.tileh;
+	Unlock(&Dmg.lock);
+
+	return TRUE;
+}
+
+/*
+	change representation of pending region, pending one is kept
+*/
+LOCAL	void	switchMode(W mode)
+{
+	W	i;
+	RECT	r;
+
+	Lock(&Dmg.lock);
+	drainQueue(FALSE);
+
+	if (mode == Dmg.mode) goto fin0;
+
+	if (mode == DMG_TILE) {
+		/* rectangles to tiles */
+		if (Dmg.fullscr) {
+			r.c.left = r.c.top = 0;
+			r.c.right = Vinf.width;
+			r.c.bottom = Vinf.height;
+			markTile(Dmg.tile, &r);
+		} else {
+			for (i = 0; i < Dmg.nrect; i++)
+				markTile(Dmg.tile, &Dmg.rect[i]);
+		}
+		Dmg.nrect = (Dmg.fullscr || Dmg.nrect > 0) ? 1 : 0;
+		Dmg.fullscr = FALSE;
+	} else {
+		/* tiles to whole screen (rare, on pacing change only) */
+		Dmg.fullscr = (Dmg.nrect > 0);
+		Dmg.nrect = 0;
+		memset(Dmg.tile, 0, sizeof(Dmg.tile));
+	}
+	Dmg.mode = mode;
+fin0:
+	Unlock(&Dmg.lock);
+	return;
+}
+
+/*
+	present pacing (cyclic handler), wake flush task once per frame
+*/
+LOCAL	void	damageCyc(void *exinf)
+{
+	if (Dmg.pending) wup_tsk(Dmg.tskid);
+	return;
+}
+
+/*
+	flush task
+*/
+LOCAL	void	damageTask(W stacd)
+{
+	while (1) {
+		if (slp_tsk() < E_OK) break;
+		if (!Dmg.cycid && Dmg.delay > 0) dly_tsk(Dmg.delay);
+		flushDamage();
+	}
+
+	exd_tsk();
+}
+
+/*
+	set present rate (Hz), 0 means update as soon as possible
+		* when paced, tile map is used and flushed once per frame
+*/
+EXPORT	ERR	setDamageRate(W hz)
+{
+	ERR	err;
+	T_CCYC	ccyc = {
+		.exinf = NULL,
+		.cycatr = TA_HLNG,
+		.cychdr = damageCyc,
+	};
+
+	if (Dmg.fn_flush == NULL) {
+		err = ER_NOSPT;
+		goto fin0;
+	}
+
+	/* stop pacing and emit what is pending */
+	if (Dmg.cycid) {
+		del_cyc(Dmg.cycid);
+		Dmg.cycid = 0;
+	}
+	switchMode((hz > 0) ? DMG_TILE : Dmg.basemode);
+	flushDamage();
+
+	err = ER_OK;
+	if (hz <= 0) goto fin0;
+
+	/* start pacing */
+	ccyc.cyctim = ccyc.cycphs = (1000 + hz - 1) / hz;
+	err = vcre_cyc(&ccyc);
+	if (err < E_OK) goto fin1;
+	Dmg.cycid = (ID)err;
+
+	err = sta_cyc(Dmg.cycid);
+	if (err < E_OK) goto fin2;
+
+	/* damage before pacing was started */
+	if (Dmg.pending) wup_tsk(Dmg.tskid);
+
+	err = ER_OK;
+	goto fin0;
+
+fin2:
+	del_cyc(Dmg.cycid);
+	Dmg.cycid = 0;
+fin1:
+	switchMode(Dmg.basemode);
+fin0:
+	return err;
+}
+
+/*
+	stop damage tracking, backend failed after initDamage()
+*/
+EXPORT	void	finishDamage(void)
+{
+	if (Dmg.fn_flush == NULL) goto fin0;
+
+	if (Dmg.cycid) {
+		del_cyc(Dmg.cycid);
+		Dmg.cycid = 0;
+	}
+	ter_tsk(Dmg.tskid);
+	del_tsk(Dmg.tskid);
+	DeleteLock(&Dmg.flock);
+	DeleteLock(&Dmg.lock);
+	Dmg.fn_flush = NULL;
+fin0:
+	return;
+}
+
+/*
+	initialization
+*/
+EXPORT	ERR	initDamage(W mode, void (*flush)(RECT *rp, W n))
+{
+	ERR	err;
+	W	i, v[L_DEVCONF_VAL];
+	T_CTSK	ctsk = {
+		.exinf = TASK_EXINF,
+		.task = damageTask,
+		.itskpri = ScrTaskPri,
+		.stksz = TASK_STKSZ,
+		.tskatr = TA_HLNG | TA_RNG0 | TA_FPU,	/* SSE (convert.c) */
+	};
+
+	/* VIDEODAMAGE: threshold(%) merge-distance(pixel) delay(msec) */
+	Dmg.full = DMG_FULL;
+	Dmg.gap = DMG_GAP;
+	Dmg.delay = DMG_DELAY;
+	if ((err = GetDevConf("VIDEODAMAGE", v)) > 0) {
+		if (err > 0 && v[0] > 0 && v[0] <= 100) Dmg.full = v[0];
+		if (err > 1 && v[1] >= 0) Dmg.gap = v[1];
+		if (err > 2 && v[2] >= 0) Dmg.delay = v[2];
+	}
+
+	Dmg.mode = Dmg.basemode = mode;
+	Dmg.cycid = 0;
+	Dmg.nrect = 0;
+	Dmg.fullscr = FALSE;
+
+	/* queue entry #i is free for position i */
+	for (i = 0; i < DMG_QUEUE; i++) Dmg.queue[i].seq = i;
+	Dmg.qtail = Dmg.qhead = 0;
+	Dmg.pending = 0;
+	Dmg.overflow = FALSE;
+
+	/* create lock */
+	err = CreateLockWN(&Dmg.lock, "vmsd");
+	if (err < ER_OK) goto fin0;
+	err = CreateLockWN(&Dmg.flock, "vmsw");
+	if (err < ER_OK) goto fin1;
+
+	/* create flush task and start */
+	err = vcre_tsk(&ctsk);
+	if (err < E_OK) goto fin2;
+	Dmg.tskid = (ID)err;
+
+	err = sta_tsk(Dmg.tskid, 0);
+	if (err < E_OK) goto fin3;
+
+	/* tracking is available from here */
+	Dmg.fn_flush = flush;
+	resetDamage();
+
+	err = ER_OK;
+	goto fin0;
+
+fin3:
+	del_tsk(Dmg.tskid);
+fin2:
+	DeleteLock(&Dmg.flock);
+fin1:
+	DeleteLock(&Dmg.lock);
+fin0:
+	return err;
+}
@@ -0,0 +1,494 @@
+/*
+	draw.c		screen driver
+	drawing processing by CPU (DN_SCRWRITE)
+
+	Copyright 2026 by agent
+	This software is distributed under the T-License 2.0.
+*/
+#include "screen.h"
+
+#define	CPUID1_EDX_SSE2		(1 << 26)
+#define	CPUID1_ECX_SSE41	(1 << 19)
+#define	CPUID1_ECX_OSXSAVE	(1 << 27)
+#define	CPUID1_ECX_AVX		(1 << 28)
+#define	CPUID7_EBX_AVX2		(1 << 5)
+#define	CR4_OSFXSR		(1 << 9)
+#define	XCR0_SSE_AVX		0x06
+
+#define	CLR_EXINF	((void *)CH4toW('v', 'm', 's', 'z'))
+#define	CLR_STKSZ	4096
+#define	CLR_DONE	0x01
+
+/* initial screen clear, done in background */
+LOCAL	ID	ClrFlgID;
+LOCAL	BOOL	ClrDone = TRUE;
+LOCAL	UW	ClrPixel;
+
+/* row copy for blit and capture, selected by initDraw() */
+LOCAL	void	copyRowCPU(UB *d, UB *s, W len);
+EXPORT	void	(*copyRow)(UB *d, UB *s, W len) = copyRowCPU;
+
+EXPORT	W	CpuSIMD = SIMD_NONE;
+
+/* raster operation (X11 GXxxx), bit i = f(!src, !dst) */
+Inline	UW	ropUW(W rop, UW s, UW d)
+{
+	UW	r = 0;
+
+	if (rop & 0x01) r |=  s &  d;
+	if (rop & 0x02) r |=  s & ~d;
+	if (rop & 0x04) r |= ~s &  d;
+	if (rop & 0x08) r |= ~s & ~d;
+	return r;
+}
+
+Inline	UB	ropUB(W rop, UB s, UB d)
+{
+	return (UB)ropUW(rop, s, d);
+}
+
+/*
+	clip destination rectangle to the screen
+	source position (if sp != NULL) follows the destination
+*/
+EXPORT	BOOL	clipRect(RECT *r, PNT *sp)
+{
+	W	n;
+
+	/* destination */
+	if ((n = -r->c.left) > 0) {
+		r->c.left = 0;
+		if (sp != NULL) sp->x += n;
+	}
+	if ((n = -r->c.top) > 0) {
+		r->c.top = 0;
+		if (sp != NULL) sp->y += n;
+	}
+	if (r->c.right > Vinf.width) r->c.right = Vinf.width;
+	if (r->c.bottom > Vinf.height) r->c.bottom = Vinf.height;
+
+	/* source */
+	if (sp != NULL) {
+		if ((n = -sp->x) > 0) {
+			sp->x = 0;
+			r->c.left += n;
+		}
+		if ((n = -sp->y) > 0) {
+			sp->y = 0;
+			r->c.top += n;
+		}
+		n = sp->x + (r->c.right - r->c.left) - Vinf.width;
+		if (n > 0) r->c.right -= n;
+		n = sp->y + (r->c.bottom - r->c.top) - Vinf.height;
+		if (n > 0) r->c.bottom -= n;
+	}
+
+	return (r->c.left < r->c.right && r->c.top < r->c.bottom);
+}
+
+/* row copy: string instruction */
+LOCAL	void	copyRowCPU(UB *d, UB *s, W len)
+{
+	memcpy(d, s, len);
+	return;
+}
+
+/* row copy: SSE2, 64 bytes per loop */
+__attribute__((target("sse2")))
+LOCAL	void	copyRowSSE2(UB *d, UB *s, W len)
+{
+	for (; len >= 64; len -= 64, s += 64, d += 64) {
+		__asm__ __volatile__ ("movdqu   (%0), %%xmm0\n\t"
+				      "movdqu 16(%0), %%xmm1\n\t"
+				      "movdqu 32(%0), %%xmm2\n\t"
+				      "movdqu 48(%0), %%xmm3\n\t"
+				      "movdqu %%xmm0,   (%1)\n\t"
+				      "movdqu %%xmm1, 16(%1)\n\t"
+				      "movdqu %%xmm2, 32(%1)\n\t"
+				      "movdqu %%xmm3, 48(%1)"
+				      : : "r"(s), "r"(d)
+				      : "memory", "xmm0", "xmm1", "xmm2", "xmm3");
+	}
+	if (len > 0) memcpy(d, s, len);
+
+	return;
+}
+
+/* row copy: AVX2, 128 bytes per loop */
+__attribute__((target("avx2")))
+LOCAL	void	copyRowAVX2(UB *d, UB *s, W len)
+{
+	for (; len >= 128; len -= 128, s += 128, d += 128) {
+		__asm__ __volatile__ ("vmovdqu   (%0), %%ymm0\n\t"
+				      "vmovdqu 32(%0), %%ymm1\n\t"
+				      "vmovdqu 64(%0), %%ymm2\n\t"
+				      "vmovdqu 96(%0), %%ymm3\n\t"
+				      "vmovdqu %%ymm0,   (%1)\n\t"
+				      "vmovdqu %%ymm1, 32(%1)\n\t"
+				      "vmovdqu %%ymm2, 64(%1)\n\t"
+				      "vmovdqu %%ymm3, 96(%1)"
+				      : : "r"(s), "r"(d)
+				      : "memory", "xmm0", "xmm1", "xmm2", "xmm3");
+	}
+	__asm__ __volatile__ ("vzeroupper");
+	if (len > 0) copyRowSSE2(d, s, len);
+
+	return;
+}
+
+/*
+	select row copy by CPU feature
+		* OS must save SSE/AVX state (CR4.OSFXSR, XCR0)
+*/
+EXPORT	void	initDraw(void)
+{
+	UW	a, b, c, d, cr4, xcr0;
+
+	cpuid(0, &a, &b, &c, &d);
+	if (a < 1) goto fin0;
+
+	cpuid(1, &a, &b, &c, &d);
+	cr4 = getCR4();
+	if (!(d & CPUID1_EDX_SSE2) || !(cr4 & CR4_OSFXSR)) goto fin0;
+	copyRow = copyRowSSE2;
+	CpuSIMD = (c & CPUID1_ECX_SSE41) ? SIMD_SSE41 : SIMD_SSE2;
+
+	if ((c & (CPUID1_ECX_OSXSAVE | CPUID1_ECX_AVX)) !=
+	    (CPUID1_ECX_OSXSAVE | CPUID1_ECX_AVX)) goto fin0;
+	__asm__ __volatile__ ("xgetbv" : "=a"(xcr0), "=d"(d) : "c"(0));
+	if ((xcr0 & XCR0_SSE_AVX) != XCR0_SSE_AVX) goto fin0;
+
+	cpuid(0, &a, &b, &c, &d);
+	if (a < 7) goto fin0;
+	cpuid(7, &a, &b, &c, &d);
+	if (b & CPUID7_EBX_AVX2) {
+		copyRow = copyRowAVX2;
+		CpuSIMD = SIMD_AVX2;
+	}
+fin0:
+	return;
+}
+
+/* pixel data to screen, source is the caller's buffer */
+LOCAL	void	blitRect(RECT *r, UB *s, W pitch)
+{
+	W	y, len;
+	UB	*d;
+
+	len = (r->c.right - r->c.left) * Vinf.pixbyte;
+	d = Vinf.baseaddr + r->c.top * Vinf.rowbytes +
+		r->c.left * Vinf.pixbyte;
+
+	for (y = r->c.top; y < r->c.bottom; y++) {
+		(*copyRow)(d, s, len);
+		d += Vinf.rowbytes;
+		s += pitch;
+	}
+	STAT_ADD(copybytes, len * (r->c.bottom - r->c.top));
+
+	return;
+}
+
+/* solid fill of a row, for each pixel size */
+LOCAL	void	fillRow8(UB *p, UW pixel, W w)
+{
+	memset(p, pixel, w);
+	return;
+}
+
+LOCAL	void	fillRow16(UB *p, UW pixel, W w)
+{
+	W	x;
+
+	for (x = 0; x < w; x++) ((UH *)p)[x] = pixel;
+	return;
+}
+
+LOCAL	void	fillRow32(UB *p, UW pixel, W w)
+{
+	W	x;
+
+	for (x = 0; x < w; x++) ((UW *)p)[x] = pixel;
+	return;
+}
+
+/* indexed by Vinf.pixbyte */
+LOCAL	void	(*CONST FillRow[])(UB *p, UW pixel, W w) = {
+	NULL, fillRow8, fillRow16, NULL, fillRow32,
+};
+
+/* solid fill */
+LOCAL	void	fillRect(RECT *r, UW pixel)
+{
+	W	y, w;
+	UB	*p;
+	void	(*fill)(UB *p, UW pixel, W w);
+
+	w = r->c.right - r->c.left;
+	p = Vinf.baseaddr + r->c.top * Vinf.rowbytes +
+		r->c.left * Vinf.pixbyte;
+	fill = FillRow[Vinf.pixbyte];
+
+	for (y = r->c.top; y < r->c.bottom; y++, p += Vinf.rowbytes) {
+		(*fill)(p, pixel, w);
+	}
+
+	return;
+}
+
+/* fill with streaming store (bypass cache), pattern is 32bit */
+__attribute__((target("sse2")))
+LOCAL	void	fillNT(UB *p, UW pat, W len)
+{
+	for (; len > 0 && ((UW)p & 15); len--, p++) *p = pat >> (((UW)p & 3) * 8);
+
+	__asm__ __volatile__ ("movd %0, %%xmm0\n\t"
+			      "pshufd $0, %%xmm0, %%xmm0"
+			      : : "r"(pat) : "xmm0");
+	for (; len >= 64; len -= 64, p += 64) {
+		__asm__ __volatile__ ("movntdq %%xmm0,   (%0)\n\t"
+				      "movntdq %%xmm0, 16(%0)\n\t"
+				      "movntdq %%xmm0, 32(%0)\n\t"
+				      "movntdq %%xmm0, 48(%0)"
+				      : : "r"(p) : "memory", "xmm0");
+	}
+	__asm__ __volatile__ ("sfence" : : : "memory");
+
+	for (; len > 0; len--, p++) *p = pat >> (((UW)p & 3) * 8);
+
+	return;
+}
+
+/* fill whole screen memory by CPU */
+LOCAL	void	clearVRAM(UW pixel)
+{
+	W	n;
+	UB	*p = Vinf.baseaddr;
+
+	/* 32bit pattern, baseaddr is aligned */
+	if (Vinf.pixbyte == 1) pixel = (pixel & 0xff) * 0x01010101;
+	else if (Vinf.pixbyte == 2) pixel = (pixel & 0xffff) * 0x00010001;
+
+	if (CpuSIMD >= SIMD_SSE2) {
+		fillNT(p, pixel, Vinf.vramsz);
+	} else {
+		n = Vinf.vramsz & ~3;
+		fillRow32(p, pixel, n / 4);
+		for (; n < Vinf.vramsz; n++) p[n] = pixel >> ((n & 3) * 8);
+	}
+	STAT_ADD(copybytes, Vinf.vramsz);
+
+	return;
+}
+
+/* finish initial clear: set color map entry #0 (white) */
+LOCAL	void	endClear(void)
+{
+	if (Vinf.cmapent > 0) (*Vinf.fn_setcmap)(Vinf.cmap, 0, 1);
+
+	/* show cleared screen now, not after coalescing delay */
+	if (Vinf.fn_updscr) {
+		(*Vinf.fn_updscr)(0, 0, Vinf.width, Vinf.height);
+		flushDamage();
+	}
+	return;
+}
+
+LOCAL	void	clearTask(W stacd)
+{
+	clearVRAM(ClrPixel);
+	endClear();
+	set_flg(ClrFlgID, CLR_DONE);
+
+	exd_tsk();
+}
+
+/*
+	initial screen clear of FrameBuffer
+		* hardware fill if the backend has one (VMware SVGA II with
+		  FIFO), otherwise clear in background and waitClear()
+		  blocks until it is done
+*/
+EXPORT	void	startClear(UW pixel)
+{
+	ERR	err;
+	ScrWrFill	fill;
+	T_CFLG	cflg = {
+		.exinf = CLR_EXINF,
+		.flgatr = TA_TFIFO | TA_WMUL,
+		.iflgptn = 0,
+	};
+	T_CTSK	ctsk = {
+		.exinf = CLR_EXINF,
+		.task = clearTask,
+		.itskpri = ScrTaskPri,
+		.stksz = CLR_STKSZ,
+		.tskatr = TA_HLNG | TA_RNG0 | TA_FPU,	/* SSE */
+	};
+
+	/* hardware fill */
+	fill.kind = SCRWR_FILL;
+	fill.r.c.left = fill.r.c.top = 0;
+	fill.r.c.right = Vinf.width;
+	fill.r.c.bottom = Vinf.height;
+	fill.pixel = pixel;
+	if (Vinf.fn_write &&
+	    (*Vinf.fn_write)(SCRWR_FILL, &fill, sizeof(fill)) >= ER_OK) {
+		goto fin1;
+	}
+
+	/* background */
+	ClrPixel = pixel;
+	err = vcre_flg(&cflg);
+	if (err < E_OK) goto fin0;
+	ClrFlgID = (ID)err;
+
+	err = vcre_tsk(&ctsk);
+	if (err < E_OK) goto fin2;
+	ClrDone = FALSE;
+	if (sta_tsk((ID)err, 0) >= E_OK) goto fin3;
+
+	del_tsk((ID)err);
+	ClrDone = TRUE;
+fin2:
+	del_flg(ClrFlgID);
+fin0:
+	/* synchronous */
+	clearVRAM(pixel);
+fin1:
+	endClear();
+fin3:
+	return;
+}
+
+/*
+	wait for initial screen clear, called before drawing request
+*/
+EXPORT	void	waitClear(void)
+{
+	UINT	ptn;
+
+	if (ClrDone) return;
+
+	wai_flg(&ptn, ClrFlgID, CLR_DONE, TWF_ORW);
+	ClrDone = TRUE;
+	del_flg(ClrFlgID);
+
+	return;
+}
+
+/* screen to screen copy, source and destination may overlap */
+LOCAL	void	copyRect(RECT *r, PNT *sp, W rop)
+{
+	W	x, y, h, len, step;
+	UB	*s, *d;
+
+	len = (r->c.right - r->c.left) * Vinf.pixbyte;
+	h = r->c.bottom - r->c.top;
+	step = Vinf.rowbytes;
+	s = Vinf.baseaddr + sp->y * step + sp->x * Vinf.pixbyte;
+	d = Vinf.baseaddr + r->c.top * step + r->c.left * Vinf.pixbyte;
+
+	/* scroll down: copy from the bottom line */
+	if (d > s) {
+		s += (h - 1) * step;
+		d += (h - 1) * step;
+		step = -step;
+	}
+
+	STAT_ADD(copybytes, len * h);
+
+	for (y = 0; y < h; y++, s += step, d += step) {
+		if (rop == SCRROP_COPY) {
+			memmove(d, s, len);
+			continue;
+		}
+
+		/* bitwise operation does not depend on pixel format */
+		if (d > s && d < s + len) {
+			for (x = len - 1; x >= 0; x--)
+				d[x] = ropUB(rop, s[x], d[x]);
+		} else {
+			for (x = 0; x + sizeof(UW) <= len; x += sizeof(UW))
+				*(UW *)(d + x) = ropUW(rop, *(UW *)(s + x),
+						      *(UW *)(d + x));
+			for (; x < len; x++)
+				d[x] = ropUB(rop, s[x], d[x]);
+		}
+	}
+
+	return;
+}
+
+/*
+	screen write processing by CPU
+*/
+EXPORT	ERR	cpuSCRWRITE(W kind, void *buf, W size)
+{
+	ERR	err;
+	W	n, len;
+	RECT	r;
+	PNT	sp;
+	ScrWrFill	*fill = buf;
+	ScrWrCopy	*copy = buf;
+	ScrWrBlit	*blit = buf;
+
+	switch (kind) {
+	case SCRWR_FILL:
+		if (size < sizeof(ScrWrFill)) {
+			err = ER_PAR;
+			goto fin0;
+		}
+		r = fill->r;
+		if (!clipRect(&r, NULL)) break;
+		fillRect(&r, fill->pixel);
+		break;
+
+	case SCRWR_COPY:
+	case SCRWR_ROPCOPY:
+		if (size < sizeof(ScrWrCopy) ||
+		    (kind == SCRWR_ROPCOPY && (copy->rop & ~0x0f))) {
+			err = ER_PAR;
+			goto fin0;
+		}
+		r = copy->r;
+		sp = copy->sp;
+		if (!clipRect(&r, &sp)) break;
+		copyRect(&r, &sp,
+			 (kind == SCRWR_COPY) ? SCRROP_COPY : copy->rop);
+		break;
+
+	case SCRWR_BLIT:
+		/* payload must hold all rows, the last one may be short */
+		r = blit->r;
+		len = (r.c.right - r.c.left) * Vinf.pixbyte;
+		n = size - (W)sizeof(ScrWrBlit) - len;
+		if (len <= 0 || r.c.bottom <= r.c.top || blit->pitch < len ||
+		    n < 0 || n / blit->pitch < r.c.bottom - r.c.top - 1) {
+			err = ER_PAR;
+			goto fin0;
+		}
+		if (!clipRect(&r, NULL)) break;
+
+		/* clipped part of the source is skipped */
+		blitRect(&r, (UB *)(blit + 1) +
+			 (r.c.top - blit->r.c.top) * blit->pitch +
+			 (r.c.left - blit->r.c.left) * Vinf.pixbyte,
+			 blit->pitch);
+		break;
+
+	default:
+		err = ER_NOSPT;
+		goto fin0;
+	}
+
+	/* update virtual VRAM screen */
+	if (Vinf.fn_updscr && r.c.left < r.c.right && r.c.top < r.c.bottom) {
+		(*Vinf.fn_updscr)(r.c.left, r.c.top, r.c.right - r.c.left,
+				  r.c.bottom - r.c.top);
+	}
+
+	err = ER_OK;
+fin0:
+	return err;
+}
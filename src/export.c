@@ -0,0 +1,380 @@
+/*
+	export.c	screen driver
+	frame export ring for headless use (DN_SCREXPORT)
+
+	Copyright 2026 by agent
+	This software is distributed under the T-License 2.0.
+*/
+#include "screen.h"
+#include "videomode.h"
+
+#define	EXP_MINSZ	(256 * 1024)	/* ring size (power of 2) */
+#define	EXP_MAXSZ	(64 * 1024 * 1024)
+#define	EXP_TMAX	4096		/* tiles having hash */
+#define	EXP_HSIZE	8192		/* hash index entries (power of 2) */
+#define	EXP_RECMAX	(sizeof(ScrExportRec) + EXP_TILE * EXP_TILE * sizeof(UW))
+
+#define	EXP_MAGIC	CH4toW('v', 'm', 's', 'x')
+
+#define	FNV_BASIS	2166136261U
+#define	FNV_PRIME	16777619U
+
+struct _expinf {
+	FastLock	lock;		/* single producer at a time */
+	ScrExportHdr	*hdr;		/* shared with consumer */
+	void		*uaddr;		/* hdr seen from user process */
+	UB		*data;
+	UW		mask;		/* ring size - 1 */
+	UW		head;		/* private copy of hdr->head */
+	UW		keydue;		/* latest head to start next keyframe */
+	UW		keymax;		/* upper limit of keyframe size */
+	UW		frame;
+	BOOL		open;		/* frame record is written */
+
+	/* geometry the hashes are for */
+	W		width;
+	W		height;
+	W		pixbits;
+	W		tcol;
+
+	/* content of each tile the consumer has, and tile having a hash */
+	UW		hash[EXP_TMAX];
+	UH		index[EXP_HSIZE];
+};
+
+LOCAL	struct _expinf	Exp;
+
+#define	tileFull(i)	(((i) % Exp.tcol + 1) * EXP_TILE <= Exp.width && \
+			 ((i) / Exp.tcol + 1) * EXP_TILE <= Exp.height)
+
+Inline	UW	getPixel(UB *p, W pb)
+{
+	switch (pb) {
+	case 1:		return *p;
+	case 2:		return *(UH *)p;
+	case 3:		return p[0] | (p[1] << 8) | (p[2] << 16);
+	default:	return *(UW *)p;
+	}
+}
+
+/* upper limit of keyframe size, including padding at the top of ring */
+LOCAL	UW	keySize(W width, W height, W pixbyte)
+{
+	W	n;
+
+	n = ((width + EXP_TILE - 1) / EXP_TILE) *
+		((height + EXP_TILE - 1) / EXP_TILE);
+	return width * height * pixbyte + n * (sizeof(ScrExportRec) + 3) +
+		sizeof(ScrExportRec) + EXP_RECMAX;
+}
+
+/* hash of tile content (FNV-1a, word by word) */
+LOCAL	UW	hashTile(UB *p, W bytes, W h)
+{
+	W	i;
+	UW	hv, w;
+
+	for (hv = FNV_BASIS; h > 0; h--, p += Vinf.rowbytes) {
+		for (i = 0; i + 4 <= bytes; i += 4) {
+			__builtin_memcpy(&w, p + i, sizeof(w));
+			hv = (hv ^ w) * FNV_PRIME;
+		}
+		for (; i < bytes; i++) hv = (hv ^ p[i]) * FNV_PRIME;
+	}
+
+	return hv;
+}
+
+/* run-length encoding as (count, pixel) pairs, -1 if not smaller than max */
+LOCAL	W	encodeRLE(UW *d, W max, UB *p, W w, W h)
+{
+	W	x, n, pb;
+	UW	c, px, run;
+
+	pb = Vinf.pixbyte;
+	c = run = 0;
+	for (n = 0; h > 0; h--, p += Vinf.rowbytes) {
+		for (x = 0; x < w; x++) {
+			px = getPixel(p + x * pb, pb);
+			if (run > 0 && px == c) {
+				run++;
+				continue;
+			}
+			if (run > 0) {
+				if (n + 8 >= max) return -1;
+				d[n / 4] = run;
+				d[n / 4 + 1] = c;
+				n += 8;
+			}
+			c = px;
+			run = 1;
+		}
+	}
+	if (n + 8 >= max) return -1;
+	d[n / 4] = run;
+	d[n / 4 + 1] = c;
+
+	return n + 8;
+}
+
+/* get contiguous space for a record and its payload */
+LOCAL	ScrExportRec	*reserve(W len)
+{
+	UW	pos, room;
+	ScrExportRec	*r;
+
+	pos = Exp.head & Exp.mask;
+	room = Exp.mask + 1 - pos;
+	if (room < len) {
+		/* skip to the top of ring */
+		if (room >= sizeof(ScrExportRec)) {
+			r = (ScrExportRec *)(Exp.data + pos);
+			memset(r, 0, sizeof(*r));
+			r->type = EXP_PAD;
+			r->len = room - sizeof(ScrExportRec);
+		}
+		Exp.head += room;
+	}
+
+	return (ScrExportRec *)(Exp.data + (Exp.head & Exp.mask));
+}
+
+/* make the record visible to consumer */
+LOCAL	void	publish(ScrExportRec *r)
+{
+	Exp.head += sizeof(*r) + r->len;
+	__sync_synchronize();
+	Exp.hdr->head = Exp.head;
+	return;
+}
+
+/* frame record, written just before the first tile of the frame */
+LOCAL	void	openFrame(BOOL key)
+{
+	ScrExportRec	*r;
+
+	if (Exp.open) return;
+
+	r = reserve(sizeof(*r));
+	r->type = key ? EXP_KEYFRAME : EXP_FRAME;
+	r->pixbits = Vinf.pixbits;
+	r->x = r->y = 0;
+	r->w = Vinf.width;
+	r->h = Vinf.height;
+	r->len = 0;
+	r->arg = ++Exp.frame;
+	if (key) Exp.hdr->keyframe = Exp.head;
+	publish(r);
+
+	Exp.open = TRUE;
+	return;
+}
+
+/* export one tile, keyframe does not refer to what consumer has */
+LOCAL	void	exportTile(W tx, W ty, BOOL key)
+{
+	W	i, j, x, y, w, h, pb, raw, len;
+	UW	hv;
+	UB	*p;
+	ScrExportRec	*r;
+
+	x = tx * EXP_TILE;
+	y = ty * EXP_TILE;
+	w = (Vinf.width - x < EXP_TILE) ? Vinf.width - x : EXP_TILE;
+	h = (Vinf.height - y < EXP_TILE) ? Vinf.height - y : EXP_TILE;
+	pb = Vinf.pixbyte;
+	p = (UB *)Vinf.baseaddr + y * Vinf.rowbytes + x * pb;
+
+	i = ty * Exp.tcol + tx;
+	hv = hashTile(p, w * pb, h);
+
+	if (!key && i < EXP_TMAX) {
+		/* damaged, but not changed */
+		if (Exp.hash[i] == hv) return;
+
+		/* the same content is in another tile (scrolled, moved) */
+		j = Exp.index[hv & (EXP_HSIZE - 1)] - 1;
+		if (j >= 0 && j != i && Exp.hash[j] == hv &&
+		    tileFull(i) && tileFull(j)) {
+			openFrame(FALSE);
+			r = reserve(sizeof(*r));
+			r->type = EXP_COPY;
+			r->pixbits = 0;
+			r->x = x;
+			r->y = y;
+			r->w = w;
+			r->h = h;
+			r->len = 0;
+			r->arg = (((j % Exp.tcol) * EXP_TILE) << 16) |
+				((j / Exp.tcol) * EXP_TILE);
+			publish(r);
+			goto fin0;
+		}
+	}
+
+	/* pixels, encoded in place */
+	openFrame(key);
+	raw = (w * pb * h + 3) & ~3;
+	r = reserve(sizeof(*r) + raw);
+	len = encodeRLE((UW *)(r + 1), raw, p, w, h);
+	if (len < 0) {
+		for (j = 0; j < h; j++) {
+			memcpy((UB *)(r + 1) + j * w * pb,
+			       p + j * Vinf.rowbytes, w * pb);
+		}
+		r->type = EXP_RAW;
+		len = raw;
+	} else {
+		r->type = EXP_RLE;
+	}
+	r->pixbits = 0;
+	r->x = x;
+	r->y = y;
+	r->w = w;
+	r->h = h;
+	r->len = len;
+	r->arg = hv;
+	publish(r);
+	STAT_ADD(copybytes, len);
+
+fin0:
+	if (i < EXP_TMAX) {
+		Exp.hash[i] = hv;
+		Exp.index[hv & (EXP_HSIZE - 1)] = i + 1;
+	}
+	return;
+}
+
+/*
+	export updated region, called by damage tracking (DMG_TILE)
+		* consumer lost its position restarts from hdr->keyframe,
+		  so the next keyframe is written before that is
+		  overwritten: it starts by keydue at the latest
+*/
+LOCAL	void	exportRect(RECT *rp, W n)
+{
+	W	tx, ty, rows;
+	UW	start;
+
+	Lock(&Exp.lock);
+
+	/* geometry changed, tiles have to be sent again */
+	if (Exp.width != Vinf.width || Exp.height != Vinf.height ||
+	    Exp.pixbits != Vinf.pixbits) {
+		Exp.width = Vinf.width;
+		Exp.height = Vinf.height;
+		Exp.pixbits = Vinf.pixbits;
+		Exp.tcol = (Vinf.width + EXP_TILE - 1) / EXP_TILE;
+		Exp.keymax = keySize(Vinf.width, Vinf.height, Vinf.pixbyte);
+		Exp.keydue = Exp.head;
+	}
+
+	/* ring can not hold two keyframes (larger than EXP_MAXSZ) */
+	if (Exp.keymax * 2 + EXP_RECMAX * 2 > Exp.mask + 1) goto fin0;
+
+	Exp.open = FALSE;
+	if ((W)(Exp.head - Exp.keydue) >= 0) goto key;
+
+	for (; n > 0; n--, rp++) {
+		for (ty = rp->c.top / EXP_TILE;
+		     ty * EXP_TILE < rp->c.bottom; ty++) {
+			for (tx = rp->c.left / EXP_TILE;
+			     tx * EXP_TILE < rp->c.right; tx++) {
+				/* tile and padding before it */
+				if ((W)(Exp.head + EXP_RECMAX * 2 -
+					Exp.keydue) > 0) goto key;
+				exportTile(tx, ty, FALSE);
+			}
+		}
+	}
+	goto fin0;
+
+key:
+	/* tiles already written in this frame are overwritten by it */
+	Exp.open = FALSE;
+	start = Exp.head;
+	memset(Exp.index, 0, sizeof(Exp.index));
+	rows = (Vinf.height + EXP_TILE - 1) / EXP_TILE;
+	for (ty = 0; ty < rows; ty++) {
+		for (tx = 0; tx < Exp.tcol; tx++) exportTile(tx, ty, TRUE);
+	}
+	Exp.keydue = start + (Exp.mask + 1) - Exp.keymax;
+fin0:
+	Unlock(&Exp.lock);
+	return;
+}
+
+/*
+	get export ring (DN_SCREXPORT)
+*/
+EXPORT	ERR	getSCREXPORT(void **ring)
+{
+	if (Exp.hdr == NULL) return ER_NOSPT;
+
+	*ring = Exp.uaddr;
+	return ER_OK;
+}
+
+/*
+	initialization, screen updates are exported through damage tracking
+		* VIDEOEXPORT: ring-size(KB), enlarged to hold two keyframes
+*/
+EXPORT	ERR	initExport(void)
+{
+	ERR	err;
+	W	m, size, need, v[L_DEVCONF_VAL];
+	ScrExportHdr	*hdr;
+
+	if (GetDevConf("VIDEOEXPORT", v) <= 0 || v[0] <= 0) {
+		err = ER_NOSPT;
+		goto fin0;
+	}
+
+	/* two keyframes of the largest mode, ring is not resized later */
+	for (m = need = 0; m < MAX_VIDEO_MODE; m++) {
+		if (!(Vinf.modemap & (1 << m))) continue;
+		size = keySize(VideoHsize(m), VideoVsize(m),
+			       ((VideoPixBits(m) >> 8) + 7) / 8);
+		if (need < size) need = size;
+	}
+	need = need * 2 + EXP_RECMAX * 2;
+
+	for (size = EXP_MINSZ;
+	     (size < v[0] * 1024 || size < need) && size < EXP_MAXSZ;
+	     size <<= 1);
+
+	err = CreateLockWN(&Exp.lock, "vmse");
+	if (err < ER_OK) goto fin0;
+
+	hdr = getSharedMemory(sizeof(ScrExportHdr) + size, &Exp.uaddr);
+	if (hdr == NULL) {
+		err = ER_NOMEM;
+		goto fin1;
+	}
+
+	memset(hdr, 0, sizeof(ScrExportHdr));
+	hdr->magic = EXP_MAGIC;
+	hdr->size = size;
+	hdr->tilesize = EXP_TILE;
+
+	Exp.data = (UB *)(hdr + 1);
+	Exp.mask = size - 1;
+	Exp.head = Exp.keydue = Exp.keymax = Exp.frame = 0;
+	Exp.width = Exp.height = Exp.pixbits = 0;
+
+	err = initDamage(DMG_TILE, exportRect);
+	if (err < ER_OK) goto fin2;
+
+	Exp.hdr = hdr;
+	Vinf.fn_updscr = addDamage;
+
+	err = ER_OK;
+	goto fin0;
+
+fin2:
+	UnmapMemory(hdr);
+fin1:
+	DeleteLock(&Exp.lock);
+fin0:
+	return err;
+}
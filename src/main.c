@@ -20,20 +20,90 @@
 #include <tstring.h>
 #include <tcode.h>
 
-LOCAL	BOOL	suspended;		/* suspended state     */
-LOCAL	ID	PorID;
-LOCAL	ID	TskID;
-
 #define	TASK_EXINF	((void *)CH4toW('v', 'm', 's', 'c'))
 #define	TASK_PRI	35
 #define	TASK_STKSZ	4096
 
+#define	MAX_WORKER	8
+#define	DEF_WORKER	2
+
+LOCAL	BOOL	suspended;		/* suspended state     */
+LOCAL	ID	PorID;
+LOCAL	ID	TskID[MAX_WORKER];
+LOCAL	W	NumWorker;		/* tasks accepting requests */
+LOCAL	FastLock	Lane;		/* serializes state changes */
+
+EXPORT	PRI	ScrTaskPri;		/* priority of driver tasks */
+
+/*
+	state for frequent queries, readers do not take the lane
+		* seq is odd while being updated
+		* screen geometry is read consistently with mode change
+*/
+typedef struct {
+	ERR		err;
+	ScrFlipInf	inf;
+} CacheFlip;
+
+typedef struct {
+	ERR		err;
+	ScrView		view;
+} CacheView;
+
+LOCAL	struct {
+	volatile UW	seq;
+	DEV_SPEC	spec;
+	W		scrno;
+	BMP		bmp;
+	CacheFlip	flip;
+	CacheView	view;
+} Cache;
+
 #define	Read	0x01
 #define	Write	0x02
 #define	R_OK	Read
 #define	W_OK	Write
 #define	RW_OK	(R_OK | W_OK)
 
+/*
+	update cached state, called in the lane
+*/
+LOCAL	void	updateCache(void)
+{
+	Cache.seq++;
+	__sync_synchronize();
+
+	getSCRSPEC(&Cache.spec);
+	getsetSCRNO(&Cache.scrno, suspended, FALSE);
+	getSCRBMP(&Cache.bmp);
+	Cache.flip.err = getsetSCRFLIP(&Cache.flip.inf, FALSE);
+	Cache.view.err = getsetSCRVIEW(&Cache.view.view, FALSE);
+
+	__sync_synchronize();
+	Cache.seq++;
+
+	return;
+}
+/*
+	read cached item p (len bytes), from the lane if it is being updated
+*/
+LOCAL	void	readCache(void *buf, void *p, W len)
+{
+	UW	seq;
+
+	seq = Cache.seq;
+	__sync_synchronize();
+	memcpy(buf, p, len);
+	__sync_synchronize();
+
+	if ((seq & 1) || seq != Cache.seq) {
+		Lock(&Lane);
+		memcpy(buf, p, len);
+		Unlock(&Lane);
+	}
+
+	return;
+}
 /*
         check parameter & set up address space
 		= ER_OK : OK (size == 0)
@@ -58,12 +128,16 @@ LOCAL	ERR	rwfn(W mode, W start, W size, void *buf, W *asize)
 	ERR	err;
 	W	dsz;
 	BOOL	set = (mode == Write);
+	CacheFlip	flip;
+	CacheView	view;
 
 	switch (start) {
 	case DN_SCRSPEC:
 		dsz = sizeof(DEV_SPEC);
-		if ((err = checkParam(mode, size, dsz, R_OK)) > ER_OK)
-			err = getSCRSPEC((DEV_SPEC*)buf);
+		if ((err = checkParam(mode, size, dsz, R_OK)) > ER_OK) {
+			readCache(buf, &Cache.spec, sizeof(DEV_SPEC));
+			err = ER_OK;
+		}
 		break;
 	case DN_SCRLIST:
 		dsz = getSCRLIST(NULL);
@@ -72,8 +146,14 @@ LOCAL	ERR	rwfn(W mode, W start, W size, void *buf, W *asize)
 		break;
 	case DN_SCRNO:
 		dsz = sizeof(W);
-		if ((err = checkParam(mode, size, dsz, RW_OK)) > ER_OK)
-			err = getsetSCRNO((W*)buf, suspended, set);
+		if ((err = checkParam(mode, size, dsz, RW_OK)) > ER_OK) {
+			if (set) {
+				err = getsetSCRNO((W*)buf, suspended, set);
+			} else {
+				readCache(buf, &Cache.scrno, sizeof(W));
+				err = ER_OK;
+			}
+		}
 		break;
 	case DN_SCRCOLOR:
 		dsz = getsetSCRCOLOR(NULL, FALSE);
@@ -82,8 +162,10 @@ LOCAL	ERR	rwfn(W mode, W start, W size, void *buf, W *asize)
 		break;
 	case DN_SCRBMP:
 		dsz = sizeof(BMP);
-		if ((err = checkParam(mode, size, dsz, R_OK)) > ER_OK)
-			err = getSCRBMP((BMP*)buf);
+		if ((err = checkParam(mode, size, dsz, R_OK)) > ER_OK) {
+			readCache(buf, &Cache.bmp, sizeof(BMP));
+			err = ER_OK;
+		}
 		break;
 	case DN_SCRBRIGHT:
 		dsz = sizeof(W);
@@ -119,10 +201,68 @@ LOCAL	ERR	rwfn(W mode, W start, W size, void *buf, W *asize)
 		if ((err = checkParam(mode, size, dsz, W_OK)) > ER_OK)
 			err = setSCRUPDRECT((RECT*)buf);
 		break;
+	case DN_SCRFENCE:
+		dsz = set ? sizeof(ScrFenceWait) : sizeof(ScrFence);
+		if ((err = checkParam(mode, size, dsz, RW_OK)) > ER_OK)
+			err = set ? setSCRFENCE((ScrFenceWait*)buf) :
+				getSCRFENCE((ScrFence*)buf);
+		break;
+	case DN_SCRCURSOR:
+		dsz = size;
+		if ((err = checkParam(mode, size, dsz, W_OK)) > ER_OK)
+			err = (dsz < sizeof(W)) ? ER_PAR :
+				setSCRCURSOR(*(W *)buf, buf, dsz);
+		break;
+	case DN_SCRFLUSH:
+		dsz = sizeof(W);
+		if ((err = checkParam(mode, size, dsz, W_OK)) > ER_OK)
+			err = setSCRFLUSH(*(W *)buf);
+		break;
 	case DN_SCRWRITE:
 		dsz = size;
 		if ((err = checkParam(mode, size, dsz, W_OK)) > ER_OK)
-			err = setSCRWRITE(0, buf, dsz);
+			err = (dsz < sizeof(W)) ? ER_PAR :
+				setSCRWRITE(*(W *)buf, buf, dsz);
+		break;
+	case DN_SCRSTATS:
+		dsz = sizeof(ScrStats);
+		if ((err = checkParam(mode, size, dsz, R_OK)) > ER_OK)
+			err = getSCRSTATS((ScrStats*)buf);
+		break;
+	case DN_SCREXPORT:
+		dsz = sizeof(void *);
+		if ((err = checkParam(mode, size, dsz, R_OK)) > ER_OK)
+			err = getSCREXPORT((void**)buf);
+		break;
+	case DN_SCRFLIP:
+		dsz = set ? sizeof(ScrFlip) : sizeof(ScrFlipInf);
+		if ((err = checkParam(mode, size, dsz, RW_OK)) > ER_OK) {
+			if (set) {
+				err = getsetSCRFLIP(buf, set);
+			} else {
+				readCache(&flip, &Cache.flip, sizeof(flip));
+				*(ScrFlipInf*)buf = flip.inf;
+				err = flip.err;
+			}
+		}
+		break;
+	case DN_SCRCAPTURE:
+		dsz = size;
+		if ((err = checkParam(mode, size, dsz, R_OK)) > ER_OK)
+			err = (dsz < sizeof(ScrCapture)) ? ER_PAR :
+				getSCRCAPTURE((ScrCapture*)buf, dsz);
+		break;
+	case DN_SCRVIEW:
+		dsz = sizeof(ScrView);
+		if ((err = checkParam(mode, size, dsz, RW_OK)) > ER_OK) {
+			if (set) {
+				err = getsetSCRVIEW((ScrView*)buf, set);
+			} else {
+				readCache(&view, &Cache.view, sizeof(view));
+				*(ScrView*)buf = view.view;
+				err = view.err;
+			}
+		}
 		break;
 	default:
 		if (start <= DN_SCRXSPEC(1) && start >= DN_SCRXSPEC(255)) {
@@ -166,13 +306,50 @@ LOCAL	ERR	checkTaskSpace(DevReq *q)
 fin0:
 	return err;
 }
+/*
+	request which may change state, served in the lane one at a time
+		* screen update only queues the region, it is not waited for
+		* cursor has its own lock, moving it must not wait
+		* waiting for fence must not block others
+		* capture reads screen memory, it must not overlap mode change
+*/
+Inline	BOOL	isMutating(DevReq *q)
+{
+	switch (q->cmd.cmd) {
+	case	DC_WRITE:
+		return (q->datano != DN_SCRUPDRECT &&
+			q->datano != DN_SCRFLUSH &&
+			q->datano != DN_SCRCURSOR &&
+			q->datano != DN_SCRFENCE);
+	case	DC_READ:
+		return (q->datano == DN_SCRCAPTURE);
+	case	DC_SUSPEND:
+	case	DC_RESUME:
+		return TRUE;
+	}
+	return FALSE;
+}
+/*
+	read of state that has no cached copy (color map, spec of each
+	mode), served in the lane so that a change is not seen halfway
+*/
+Inline	BOOL	isLaneRead(DevReq *q)
+{
+	return (q->cmd.cmd == DC_READ &&
+		(q->datano == DN_SCRCOLOR ||
+		 (q->datano <= DN_SCRXSPEC(1) &&
+		  q->datano >= DN_SCRXSPEC(255))));
+}
 /*
 	I/O request processing
 */
-LOCAL	ERR	doRequest(DevReq *q, DevRsp *r)
+LOCAL	ERR	serveRequest(DevReq *q, DevRsp *r)
 {
 	ERR	err;
 
+	/* screen may be still being cleared */
+	if (q->cmd.cmd == DC_READ || q->cmd.cmd == DC_WRITE) waitClear();
+
 	switch (q->cmd.cmd) {
 	case	DC_READ:
 		err = checkTaskSpace(q);
@@ -222,12 +399,32 @@ LOCAL	ERR	doRequest(DevReq *q, DevRsp *r)
 
 	return err;
 }
+LOCAL	ERR	doRequest(DevReq *q, DevRsp *r)
+{
+	ERR	err;
+
+	if (isMutating(q)) {
+		Lock(&Lane);
+		err = serveRequest(q, r);
+		updateCache();
+		Unlock(&Lane);
+	} else if (isLaneRead(q)) {
+		Lock(&Lane);
+		err = serveRequest(q, r);
+		Unlock(&Lane);
+	} else {
+		err = serveRequest(q, r);
+	}
+
+	return err;
+}
 /*
-	main task
+	worker task, every worker accepts on the same port
 */
 LOCAL	void	mainTask(UW calptn)
 {
 	W	er, size;
+	UW	t0;
 	RNO	rno;
 	DevReq	q;
 	DevRsp	r;
@@ -241,7 +438,9 @@ LOCAL	void	mainTask(UW calptn)
 		r.devid = q.devid;
 		r.cmd = q.cmd;
 		r.datano = q.datano;
+		t0 = statClock();
 		r.error.err = doRequest(&q, &r);
+		statRequest(q.datano, statClock() - t0);
 
 		rpl_rdv(rno, (void *)&r, sizeof(r));
 	}
@@ -266,12 +465,24 @@ LOCAL	PRI	getTaskPri(TC *arg)
 
 	return (pri > 0) ? pri : TASK_PRI;
 }
+/*
+	number of worker tasks : VIDEOWORKER
+*/
+LOCAL	W	getWorkers(void)
+{
+	W	v[L_DEVCONF_VAL];
+
+	if (GetDevConf("VIDEOWORKER", v) <= 0 || v[0] <= 0) return DEF_WORKER;
+
+	return (v[0] > MAX_WORKER) ? MAX_WORKER : v[0];
+}
 /*
 	startup
 */
 EXPORT	ERR	main(Bool start, TC *arg)
 {
 	ERR	err;
+	W	i, n;
 	T_CPOR	cpor = {
 		.exinf = TASK_EXINF,
 		.poratr = TA_NULL,
@@ -283,7 +494,7 @@ EXPORT	ERR	main(Bool start, TC *arg)
 		.task = mainTask,
 		.itskpri = 0,
 		.stksz = TASK_STKSZ,
-		.tskatr = TA_HLNG | TA_RNG0,
+		.tskatr = TA_HLNG | TA_RNG0 | TA_FPU,	/* SSE (draw.c) */
 	};
 	LOCAL	const DevDef	def = {
 		.attr = {
@@ -318,28 +529,38 @@ EXPORT	ERR	main(Bool start, TC *arg)
 	}
 	PorID = (ID)err;
 
-	/* create task and start */
-	ctsk.itskpri = getTaskPri(arg);
-	err = vcre_tsk(&ctsk);
-	if (err < E_OK) {
-		err = toERR(EC_INNER, err);
-		goto fin1;
+	/* create lock of the lane */
+	err = CreateLockWN(&Lane, "vmsl");
+	if (err < ER_OK) goto fin1;
+
+	/* create worker tasks and start, fewer ones are acceptable */
+	ctsk.itskpri = ScrTaskPri = getTaskPri(arg);
+	n = getWorkers();
+	for (NumWorker = 0; NumWorker < n; NumWorker++) {
+		err = vcre_tsk(&ctsk);
+		if (err < E_OK) break;
+		TskID[NumWorker] = (ID)err;
+
+		err = sta_tsk(TskID[NumWorker], D_NORM_PTN | D_ABORT_PTN);
+		if (err < E_OK) {
+			del_tsk(TskID[NumWorker]);
+			break;
+		}
 	}
-	TskID = (ID)err;
-
-	err = sta_tsk(TskID, D_NORM_PTN | D_ABORT_PTN);
-	if (err < E_OK) {
+	if (NumWorker == 0) {
 		err = toERR(EC_INNER, err);
 		goto fin2;
 	}
 
 	/* initialization */
 	suspended = FALSE;
+	initStats();		/* counters work without shared page */
 
 	/* device initialization processing */
 	if ((err = initSCREEN()) < ER_OK) {
 		goto fin3;
 	}
+	updateCache();
 
 	/* register device */
 	ddef = def;
@@ -358,9 +579,12 @@ fin4:
 	ddef.portid = -1;
 	DefDevice(&ddef, NULL);
 fin3:
-	ter_tsk(TskID);
+	for (i = 0; i < NumWorker; i++) {
+		ter_tsk(TskID[i]);
+		del_tsk(TskID[i]);
+	}
 fin2:
-	del_tsk(TskID);
+	DeleteLock(&Lane);
 fin1:
 	del_por(PorID);
 fin0:
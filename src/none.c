@@ -7,39 +7,24 @@
 */
 #include "screen.h"
 #include "videomode.h"
-#include <btron/memory.h>
 
 #ifdef USE_DEVICE_VIDEOMODE_H
 #define	VIDEOMODE	DM1600x32
+#define	SUPPORT_MODEMAP	(1 << VIDEOMODE)
 #else
 #define	VIDEOMODE	0
+#define	SUPPORT_MODEMAP	ALL_VIDEO_MODE
 #endif
 
-#define	SUPPORT_MODEMAP	(1 << VIDEOMODE)
-
-#define	NONE_VRAM_SIZE	16777216
+#define	NONE_VRAM_SIZE	16777216	/* upper limit, not allocated */
 
 LOCAL	ERR	Nonesetup(void)
 {
-	ERR	err;
-	W	nblk;
-	M_STATE	sts;
-
 	Vinf.framebuf_addr = NULL;
 	Vinf.framebuf_total = NONE_VRAM_SIZE;
+	Vinf.f_addr = NULL;
 
-	/* get memory block size */
-	err = b_mbk_sts(&sts);
-	if (err < ER_OK) goto fin0;
-	nblk = (Vinf.framebuf_total - 1) / sts.blksz + 1;
-
-	/* allocate (dummy) FrameBuffer */
-	err = b_get_mbk(&Vinf.f_addr, nblk, M_SYSTEM | M_RESIDENT);
-	if (err < ER_OK) goto fin0;
-
-	err = ER_OK;
-fin0:
-	return err;
+	return ER_OK;
 }
 
 /* set color map */
@@ -77,22 +62,29 @@ EXPORT	W	NoneInit(void)
 	if (err < ER_OK) goto fin0;
 
 	/* set Vinf */
-	Vinf.reqmode = Vinf.curmode = VIDEOMODE;
+	setModeMap(SUPPORT_MODEMAP, VIDEOMODE, 0, 0);
 	// Vinf.framebuf_addr is already set
-	// Vinf.f_addr is already set
+	// Vinf.f_addr is set below
 	strncpy(Vinf.chipinf, "None", L_CHIPINF);
 	// Vinf.framebuf_total is already set
 	Vinf.attr |= (LINEAR_FRAMEBUF | NEED_FINPROC);
 	Vinf.attr &= ~(BPP_24 | USE_VVRAM);
+	Vinf.scanbits = 0;	/* no scanout */
 	Vinf.fn_setcmap = Nonesetcmap;
 	Vinf.fn_setmode = Nonesetmode;
-	Vinf.modemap = SUPPORT_MODEMAP;
+
+	/* frame export : VIDEOEXPORT */
+	initExport();
 
 	/* these values are temporally, fix them at Nonesetmode() */
 	Vinf.fb_width = Vinf.framebuf_rowb = VideoHsize(Vinf.reqmode);
 	Vinf.fb_height = VideoVsize(Vinf.reqmode);
 	Vinf.framebuf_rowb *= (VideoPixBits(Vinf.reqmode) >> 11) & 0x1f;
 
+	/* allocate (dummy) FrameBuffer for the largest mode */
+	err = allocFrameBuf();
+	if (err < ER_OK) goto fin0;
+
 	err = 1;
 	goto fin0;
 
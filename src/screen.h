@@ -22,6 +22,7 @@
 #include <device/screen.h>
 #include <driver/pcat/sys.h>
 #include <btron/dp.h>
+#include "cpu.h"
 
 #ifdef	DEBUG
 #define	DP(exp)		printf exp
@@ -66,6 +67,8 @@ typedef	struct {
 	void	*baseaddr;		/* effective VRAM logical address       */
 	W	rowbytes;		/* row bytes of effective VRAM                */
 	W	vramsz;			/* effective VRAM size          */
+	W	f_size;			/* mapped size of real VRAM     */
+	W	v_size;			/* allocated size of virtual VRAM */
 	W	vramrng;		/* VRAM protection level            */
 
 	W	cmapent;		/* number of entries in color map  */
@@ -73,6 +76,8 @@ typedef	struct {
 
 	W	pixbyte;		/* number of bytes per one pixel     */
 
+	W	scanbits;		/* pixbits of scanout (0: same as pixbits) */
+
 	W	rotate;			/* whether screen is rotated                        */
 	W	fb_width;		/* framebuffer width (pixel)      */
 	W	fb_height;		/* framebuffer height (pixel) */
@@ -99,6 +104,27 @@ typedef	struct {
         /* suspend / resume processing (TRUE=suspend, FALSE=resume) */
 	void	(*fn_susres)(BOOL suspend);
 
+        /* page flip processing */
+	ERR	(*fn_flip)(W buf, W mode);
+	W	flipbuf;		/* number of flip buffers          */
+	W	flipfront;		/* buffer being displayed          */
+	W	flipprev;		/* buffer possibly still displayed */
+
+        /* viewport processing (width = 0: move visible area only) */
+	ERR	(*fn_view)(W width, W height, W x, W y);
+	W	viewx;			/* position of visible area        */
+	W	viewy;
+
+        /* wait until the device has processed updates */
+	ERR	(*fn_sync)(void);
+
+        /* present fence: insert (returns ID, 0: already processed), wait */
+	UW	(*fn_fence)(void);
+	ERR	(*fn_fencewait)(UW id, W tmout);
+
+        /* mouse cursor processing (ER_NOSPT: software cursor) */
+	ERR	(*fn_cursor)(W kind, void *buf, W size);
+
         /* pointer to extended work area */
 	void	*extwrk;
 } VideoInf;
@@ -112,15 +138,280 @@ typedef	struct {
 
 #define	SUPPORT_VFREQ		0x0200	/* VFREQ is supported          */
 #define	USE_VVRAM		0x1000	/* use virtual VRAM forcibly                */
+#define	USE_WCOMBINE		0x2000	/* map framebuffer write-combining          */
 #define	NEED_FINPROC		0x10000	/* termination processing is necessary              */
 #define	NEED_SUSRESPROC		0x20000	/* suspend/resume processing is necessary  */
 
+/*
+        screen write (DN_SCRWRITE) request
+*/
+#define	SCRWR_FILL	1	/* solid rectangle fill               */
+#define	SCRWR_COPY	2	/* screen to screen copy              */
+#define	SCRWR_ROPCOPY	3	/* screen to screen copy with raster op. */
+#define	SCRWR_BLIT	4	/* pixel data to screen               */
+
+typedef struct {
+	W	kind;		/* SCRWR_FILL                         */
+	RECT	r;		/* destination                        */
+	UW	pixel;		/* pixel value                        */
+} ScrWrFill;
+
+typedef struct {
+	W	kind;		/* SCRWR_COPY, SCRWR_ROPCOPY          */
+	RECT	r;		/* destination                        */
+	PNT	sp;		/* source (left-top)                  */
+	W	rop;		/* raster operation (SCRWR_ROPCOPY)   */
+} ScrWrCopy;
+
+typedef struct {
+	W	kind;		/* SCRWR_BLIT                         */
+	RECT	r;		/* destination                        */
+	W	pitch;		/* bytes per row of pixel data        */
+	/* pixel data (screen format) follows, row #0 is r.c.top */
+} ScrWrBlit;
+
+/* raster operation (same as X11 GXxxx) */
+#define	SCRROP_CLEAR	0x0	/* 0                  */
+#define	SCRROP_AND	0x1	/* src AND dst        */
+#define	SCRROP_COPY	0x3	/* src                */
+#define	SCRROP_NOOP	0x5	/* dst                */
+#define	SCRROP_XOR	0x6	/* src XOR dst        */
+#define	SCRROP_OR	0x7	/* src OR dst         */
+#define	SCRROP_INVERT	0xa	/* NOT dst            */
+#define	SCRROP_SET	0xf	/* 1                  */
+
+/*
+        page flip (DN_SCRFLIP)
+                * buffer #n starts at baseaddr + vramsz * n
+*/
+#define	MAX_FLIPBUF	3
+
+#define	FLIP_IMMEDIATE	0	/* switch now (may tear)              */
+#define	FLIP_VSYNC	1	/* switch at vertical retrace         */
+#define	FLIP_MAILBOX	2	/* switch now, latest one is shown at
+				   next refresh (needs 3 buffers)     */
+
+typedef struct {
+	W	buf;		/* buffer to be displayed             */
+	W	mode;		/* FLIP_xxx                           */
+} ScrFlip;			/* write */
+
+typedef struct {
+	W	nbuf;		/* number of buffers                  */
+	W	front;		/* buffer being displayed             */
+	W	back;		/* buffer to be drawn next            */
+	void	*baseaddr[MAX_FLIPBUF];
+} ScrFlipInf;			/* read */
+
+/*
+        viewport (DN_SCRVIEW)
+                * visible area (DN_SCRSPEC size) shows (x, y) of virtual
+                  screen, which starts at baseaddr of DN_SCRBMP
+                * moving visible area is a register write, no pixel moves
+                * changing virtual size clears the screen, page flip is
+                  available only while it is the visible size
+                * width, height = 0: virtual size is not changed
+*/
+typedef struct {
+	W	x, y;		/* position of visible area           */
+	W	width, height;	/* virtual screen size                */
+} ScrView;			/* read / write */
+
+/*
+        screen capture (DN_SCRCAPTURE)
+                * read: buffer begins with ScrCapture filled by caller,
+                  pixels of r follow it (rows are packed, row #0 is
+                  r.c.top)
+                * CAPT_CHANGED copies only the region changed since the
+                  last capture, the rest of the buffer is left as it
+                  is: call again with the same buffer and rectangle
+                * changed region is known when damage is tracked
+                  (virtual VRAM, export), otherwise all is copied
+*/
+#define	CAPT_ALL	0	/* copy whole rectangle               */
+#define	CAPT_CHANGED	1	/* copy changed region only           */
+
+#define	CAPT_XRGB	0x2018	/* pixbits of xRGB8888                */
+
+typedef struct {
+	RECT	r;		/* region to capture                  */
+	W	pixbits;	/* 0: screen format, CAPT_XRGB        */
+	W	mode;		/* CAPT_xxx                           */
+	RECT	changed;	/* bounding box of copied region (out) */
+} ScrCapture;			/* read */
+
+/*
+        performance counters (DN_SCRSTATS)
+                * available when built with options=stats (SCREEN_STATS)
+                * time is in CPU clock (TSC) cycles
+*/
+#define	SCRSTAT_NREQ	24
+
+typedef struct {
+	UW	req[SCRSTAT_NREQ];	/* requests per data number:
+					   #0-4   DN_SCRSPEC..DN_SCRBMP
+					   #5-21  DN_SCRBRIGHT..(-316)
+					   #22    DN_SCRXSPEC(x)
+					   #23    others                  */
+	UW	updscr;		/* fn_updscr calls                    */
+	UW	fifocmd;	/* FIFO commands written              */
+	UW	fifosync;	/* forced FIFO synchronization        */
+	UW	spin;		/* busy-poll iterations               */
+	UW	contend;	/* device lock contention             */
+	UW	palette;	/* palette entries written            */
+	UW	copybytes;	/* bytes copied by CPU                */
+	UW	svccnt;		/* requests served by worker tasks    */
+	UW	svcmin;		/* minimum service time               */
+	UW	svcavg;		/* service time (moving average)      */
+	UW	svcmax;		/* maximum service time               */
+	UW	fencecnt;	/* completed fences waited for        */
+	UW	fencelat;	/* present latency (moving average)   */
+	void	*shared;	/* read-only mapping of the counters
+				   for user process (NULL: none)      */
+} ScrStats;
+
+#ifdef SCREEN_STATS
+IMPORT	ScrStats	*Stat;
+#define	STAT_INC(x)	__sync_fetch_and_add(&Stat->x, 1)
+#define	STAT_ADD(x, n)	__sync_fetch_and_add(&Stat->x, (n))
+IMPORT	UW	statClock(void);
+IMPORT	void	statRequest(W dn, UW cycles);
+IMPORT	void	statFence(UW cycles);
+#else
+#define	STAT_INC(x)
+#define	STAT_ADD(x, n)
+#define	statClock()		0
+#define	statRequest(dn, cycles)	((void)(cycles))
+#define	statFence(cycles)	((void)(cycles))
+#endif
+
+/*
+        mouse cursor (DN_SCRCURSOR)
+                * chip draws it if possible, otherwise driver composes it
+                  at flush of virtual VRAM (ER_NOSPT without that)
+                * position is where the hotspot is
+*/
+#define	CURSOR_MAX	64	/* maximum width / height             */
+
+#define	SCRCUR_SHAPE	1	/* define image                       */
+#define	SCRCUR_MOVE	2	/* move, show / hide                  */
+
+typedef struct {
+	W	kind;		/* SCRCUR_SHAPE                       */
+	W	w, h;		/* size (1..CURSOR_MAX)               */
+	W	hotx, hoty;	/* hotspot in the image               */
+	/* w * h pixels of ARGB8888 (premultiplied alpha) follow      */
+} ScrCurShape;
+
+typedef struct {
+	W	kind;		/* SCRCUR_MOVE                        */
+	W	x, y;		/* position                           */
+	W	visible;	/* 0: hidden                          */
+} ScrCurPos;
+
+/*
+        flush screen updates (DN_SCRFLUSH)
+                * DN_SCRUPDRECT only queues the region and returns
+*/
+#define	FLUSH_EMIT	0	/* send queued updates to the device  */
+#define	FLUSH_WAIT	1	/* and wait until they are processed  */
+
+/*
+        present fence (DN_SCRFENCE)
+                * read sends queued updates and returns a new fence,
+                  it completes when the device has processed them
+                * write waits for completion, ER_TMOUT if not yet
+                * completes immediately if the device does not queue
+*/
+typedef struct {
+	UW	seq;		/* fence sequence number              */
+} ScrFence;			/* read */
+
+typedef struct {
+	UW	seq;		/* fence to wait for                  */
+	W	tmout;		/* msec (0: poll, -1: forever)        */
+} ScrFenceWait;			/* write */
+
+/*
+        frame export ring (DN_SCREXPORT), None backend
+                * read gives user address of ScrExportHdr (read only),
+                  records follow the header, ring wraps at size
+                * a record and its payload never wrap, EXP_PAD (or less
+                  space than a record) means to continue from the top
+                * consumer reads records up to head, then checks head
+                  again: if it went past tail + size, data was
+                  overwritten, restart from keyframe
+                * ring is sized to hold two keyframes of the largest
+                  mode, the last keyframe is kept until the next one
+                  is complete
+*/
+#define	EXP_TILE	64	/* tile size (pixel)                  */
+
+#define	EXP_PAD		0	/* skip to the top of ring            */
+#define	EXP_FRAME	1	/* frame start, arg: sequence number  */
+#define	EXP_KEYFRAME	2	/* frame start, every tile follows    */
+#define	EXP_RAW		3	/* pixels, rows are packed            */
+#define	EXP_RLE		4	/* (UW count, UW pixel) pairs         */
+#define	EXP_COPY	5	/* copy tile, arg: (x << 16) | y      */
+
+typedef struct {
+	UW	magic;		/* 'vmsx'                             */
+	UW	size;		/* size of ring (power of 2)          */
+	volatile UW	head;	/* bytes written (modulo 2^32)        */
+	volatile UW	keyframe;	/* head at the last keyframe  */
+	UW	tilesize;	/* EXP_TILE                           */
+	UW	rsv[3];
+} ScrExportHdr;
+
+typedef struct {
+	UH	type;		/* EXP_xxx                            */
+	UH	pixbits;	/* EXP_FRAME, EXP_KEYFRAME            */
+	UH	x, y, w, h;	/* frame: (0, 0, width, height)       */
+	UW	len;		/* payload size (multiple of 4)       */
+	UW	arg;		/* EXP_RAW, EXP_RLE: tile hash        */
+} ScrExportRec;
+
 /*
         vertical sync frequency (refresh rate) (Hz)
 */
 #define	MIN_VFREQ	40		/* minimum */
 #define	MAX_VFREQ	100		/* maximum */
 
+/*
+        make buffered (write-combining) framebuffer stores visible
+                * needed before the device is told to read VRAM
+*/
+#define	flushWC()	do { if (Vinf.attr & USE_WCOMBINE) drainWC(); } while (0)
+
+/*
+        scanout format (differs from pixbits when converted, convert.c)
+*/
+#define	ScanBits	(Vinf.scanbits ? Vinf.scanbits : Vinf.pixbits)
+#define	ScanByte	(((ScanBits >> 8) + 7) / 8)
+
+/* RGB565 -> xRGB8888, low bits are filled by high bits */
+#define	EXP565(p)	((((p) & 0xf800) << 8) | (((p) & 0xe000) << 3) | \
+			 (((p) & 0x07e0) << 5) | (((p) & 0x0600) >> 1) | \
+			 (((p) & 0x001f) << 3) | (((p) & 0x001c) >> 2))
+
+/*
+        SIMD instruction set usable in the driver (draw.c)
+*/
+#define	SIMD_NONE	0
+#define	SIMD_SSE2	1
+#define	SIMD_SSE41	2
+#define	SIMD_AVX2	3
+
+/*
+        CPU identification (sub-leaf 0)
+*/
+Inline	void	cpuid(UW op, UW *a, UW *b, UW *c, UW *d)
+{
+	__asm__ __volatile__ ("cpuid"
+			      : "=a"(*a), "=b"(*b), "=c"(*c), "=d"(*d)
+			      : "a"(op), "c"(0));
+}
+
 /*
         judge whether user process can access real VRAM access or not
                 * this is valid only when virtual VRAM is not used
@@ -138,6 +429,7 @@ IMPORT	VideoInf	Vinf;
 /* common.c */
 IMPORT	ERR	getMemory(W size, void **ptr);
 IMPORT	void*	getPhyMemory(W size, void **phyaddr);
+IMPORT	void*	getSharedMemory(W size, void **uaddr);
 IMPORT	ERR	mapFrameBuf(void *paddr, W len, void **laddr);
 IMPORT	ERR	initSCREEN(void);
 IMPORT	ERR	finishSCREEN(void);
@@ -156,7 +448,64 @@ IMPORT	ERR	getsetSCRVFREQ(W *vfreq, BOOL set);
 IMPORT	ERR	getsetSCRADJUST(ScrAdjust *adj, BOOL set);
 IMPORT	ERR	getSCRDEVINFO(ScrDevInfo *inf);
 IMPORT	ERR	setSCRUPDRECT(RECT *rp);
+IMPORT	ERR	setSCRFLUSH(W mode);
+IMPORT	ERR	getSCRFENCE(ScrFence *fence);
+IMPORT	ERR	setSCRFENCE(ScrFenceWait *wait);
 IMPORT	ERR	setSCRWRITE(W kind, void *buf, W size);
+IMPORT	ERR	getsetSCRFLIP(void *buf, BOOL set);
+IMPORT	ERR	getsetSCRVIEW(ScrView *view, BOOL set);
+IMPORT	void	setModeMap(UW map, W defmode, W maxw, W maxh);
+IMPORT	ERR	allocFrameBuf(void);
+IMPORT	ERR	allocVVRAM(void);
+
+/* draw.c */
+IMPORT	W	CpuSIMD;
+IMPORT	void	(*copyRow)(UB *d, UB *s, W len);
+IMPORT	void	initDraw(void);
+IMPORT	void	startClear(UW pixel);
+IMPORT	void	waitClear(void);
+IMPORT	BOOL	clipRect(RECT *r, PNT *sp);
+IMPORT	ERR	cpuSCRWRITE(W kind, void *buf, W size);
+
+/* convert.c */
+IMPORT	ERR	initConvert(W pixbits);
+IMPORT	void	convRect(RECT *rp, W n);
+IMPORT	void	convSetCmap(COLOR *cmap, W index, W entries);
+IMPORT	void	expandRow(UB *d, UB *s, W n, W pb);
+
+/* capture.c */
+IMPORT	ERR	getSCRCAPTURE(ScrCapture *cap, W size);
+
+/* cursor.c */
+IMPORT	ERR	initCursor(void);
+IMPORT	ERR	setSCRCURSOR(W kind, void *buf, W size);
+IMPORT	void	drawCursor(RECT *rp, W n);
+
+/* damage.c */
+#define	DMG_RECT	0	/* merge rectangles (fewer update commands) */
+#define	DMG_TILE	1	/* dirty tiles (less memory copy)           */
+#define	DMG_TILEROW	256	/* rows of tile map                         */
+
+IMPORT	ERR	initDamage(W mode, void (*flush)(RECT *rp, W n));
+IMPORT	void	finishDamage(void);
+IMPORT	void	addDamage(W x, W y, W dx, W dy);
+IMPORT	void	flushDamage(void);
+IMPORT	void	holdDamage(void);
+IMPORT	void	releaseDamage(void);
+IMPORT	void	resetDamage(void);
+IMPORT	ERR	setDamageRate(W hz);
+IMPORT	BOOL	takeChanged(RECT *r, UW *tile, W *tilew, W *tileh);
+
+/* export.c */
+IMPORT	ERR	initExport(void);
+IMPORT	ERR	getSCREXPORT(void **ring);
+
+/* main.c */
+IMPORT	PRI	ScrTaskPri;
+
+/* stats.c */
+IMPORT	ERR	initStats(void);
+IMPORT	ERR	getSCRSTATS(ScrStats *st);
 
 /* (controller dependent) */
 IMPORT	W	getSpecSCRXSPEC(DEV_SPEC *spec, W mode);
@@ -168,5 +517,13 @@ IMPORT	W	getSpecSCRLIST(TC *str, W pos);
 #define	DN_SCRMEMCLK	-304
 #define	DN_SCRUPDRECT	-305
 #define	DN_SCRWRITE	-306
+#define	DN_SCRFLIP	-307
+#define	DN_SCRSTATS	-308
+#define	DN_SCREXPORT	-309
+#define	DN_SCRFLUSH	-311	/* -310 is DN_SCRDEVINFO */
+#define	DN_SCRCURSOR	-312
+#define	DN_SCRFENCE	-313
+#define	DN_SCRVIEW	-314
+#define	DN_SCRCAPTURE	-315
 #define	DN_SCRXSPEC0	-500
 #define	DN_SCRXSPEC(x)	(DN_SCRXSPEC0 - ((x) & 0xff))
@@ -0,0 +1,117 @@
+/*
+	stats.c		screen driver
+	performance counters (DN_SCRSTATS)
+
+	Copyright 2026 by agent
+	This software is distributed under the T-License 2.0.
+*/
+#include "screen.h"
+
+#ifdef SCREEN_STATS
+
+#define	STAT_PAGESZ	4096	/* shared page (also mapped to user) */
+#define	AVG_SHIFT	4	/* weight of moving average (1/16) */
+
+LOCAL	ScrStats	StatBuf;	/* used if shared page is unavailable */
+EXPORT	ScrStats	*Stat = &StatBuf;
+
+/* request counter slot */
+LOCAL	W	statSlot(W dn)
+{
+	if (dn <= DN_SCRSPEC && dn > DN_SCRSPEC - 5)
+		return DN_SCRSPEC - dn;
+	if (dn <= DN_SCRBRIGHT && dn > DN_SCRBRIGHT - 17)
+		return 5 + DN_SCRBRIGHT - dn;
+	if (dn <= DN_SCRXSPEC(1) && dn >= DN_SCRXSPEC(255))
+		return SCRSTAT_NREQ - 2;
+
+	return SCRSTAT_NREQ - 1;
+}
+
+/*
+	time stamp counter (lower 32bit)
+*/
+EXPORT	UW	statClock(void)
+{
+	UW	lo, hi;
+
+	__asm__ __volatile__ ("rdtsc" : "=a"(lo), "=d"(hi));
+	return lo;
+}
+
+/*
+	count request and its service time, called by worker tasks
+		* minimum / maximum / average may miss a racing update
+*/
+EXPORT	void	statRequest(W dn, UW cycles)
+{
+	STAT_INC(req[statSlot(dn)]);
+
+	if (!STAT_INC(svccnt)) {
+		Stat->svcmin = Stat->svcmax = Stat->svcavg = cycles;
+	} else {
+		if (Stat->svcmin > cycles) Stat->svcmin = cycles;
+		if (Stat->svcmax < cycles) Stat->svcmax = cycles;
+		Stat->svcavg += (W)(cycles - Stat->svcavg) >> AVG_SHIFT;
+	}
+
+	return;
+}
+
+/*
+	present latency, from fence insertion to its completion was seen
+*/
+EXPORT	void	statFence(UW cycles)
+{
+	if (!STAT_INC(fencecnt)) {
+		Stat->fencelat = cycles;
+	} else {
+		Stat->fencelat += (W)(cycles - Stat->fencelat) >> AVG_SHIFT;
+	}
+
+	return;
+}
+
+/*
+	get counters
+*/
+EXPORT	ERR	getSCRSTATS(ScrStats *st)
+{
+	memcpy(st, Stat, sizeof(ScrStats));
+	return ER_OK;
+}
+
+/*
+	initialization, map counters to user space as read only
+*/
+EXPORT	ERR	initStats(void)
+{
+	ERR	err;
+	void	*la, *ua;
+
+	la = getSharedMemory(STAT_PAGESZ, &ua);
+	if (la == NULL) {
+		err = ER_NOMEM;
+		goto fin0;
+	}
+
+	memset(la, 0, STAT_PAGESZ);
+	Stat = la;
+	Stat->shared = ua;
+
+	err = ER_OK;
+fin0:
+	return err;
+}
+
+#else
+EXPORT	ERR	getSCRSTATS(ScrStats *st)
+{
+	return ER_NOSPT;	/* not supported */
+}
+
+EXPORT	ERR	initStats(void)
+{
+	return ER_OK;
+}
+#endif
@@ -2,35 +2,33 @@
 #include <device/pcat/videomode.h>
 
 #else
-#define	MAX_VIDEO_MODE		1
-#define	VALID_VIDEO_MODE(mode)	0
+#define	MAX_VIDEO_MODE		11
+#define	VALID_VIDEO_MODE(mode)	((mode) >= 0 && (mode) < MAX_VIDEO_MODE)
+#define	ALL_VIDEO_MODE		((1 << MAX_VIDEO_MODE) - 1)
 
-#define	VideoHsize(mode) ((Vinf.attr & USE_VVRAM) ? 3840 : \
+/* mode #0 is chosen by framebuffer size, others are fixed (common.c) */
+IMPORT	CONST	UH	VideoModeSize[MAX_VIDEO_MODE][2];
+
+#define	VideoHsize(mode) ((mode) ? VideoModeSize[mode][0] : \
 			  (Vinf.framebuf_total >= 16777216) ? 2560 : 1920)
-#define	VideoVsize(mode) ((Vinf.attr & USE_VVRAM) ? 1920 : \
+#define	VideoVsize(mode) ((mode) ? VideoModeSize[mode][1] : \
 			  (Vinf.framebuf_total >= 16777216) ? 1600 : 1080)
 
-#if defined(COLOR_CMAP256)
-#define	VideoPixBits(mode)	0x0808
-#define	VideoCmapEnt(mode)	256
-#define	VideoRedInf(mode)	0
-#define	VideoGreenInf(mode)	0
-#define	VideoBlueInf(mode)	0
-
-#elif defined(COLOR_RGB565)
-#define	VideoPixBits(mode)	0x1010
-#define	VideoCmapEnt(mode)	0
-#define	VideoRedInf(mode)	0x0b05
-#define	VideoGreenInf(mode)	0x0506
-#define	VideoBlueInf(mode)	0x0005
+/* color format, selected at initialization (common.c) */
+typedef struct {
+	UH	pixbits;
+	UH	cmapent;
+	UH	red;
+	UH	green;
+	UH	blue;
+} VideoFormat;
 
-#else
-#define	VideoPixBits(mode)	0x2018
-#define	VideoCmapEnt(mode)	0
-#define	VideoRedInf(mode)	0x1008
-#define	VideoGreenInf(mode)	0x0808
-#define	VideoBlueInf(mode)	0x0008
+IMPORT	CONST	VideoFormat	*VideoFmt;
 
-#endif
+#define	VideoPixBits(mode)	(VideoFmt->pixbits)
+#define	VideoCmapEnt(mode)	(VideoFmt->cmapent)
+#define	VideoRedInf(mode)	(VideoFmt->red)
+#define	VideoGreenInf(mode)	(VideoFmt->green)
+#define	VideoBlueInf(mode)	(VideoFmt->blue)
 
 #endif
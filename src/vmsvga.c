@@ -11,23 +11,37 @@
 #include <driver/pcat/sys.h>
 #include <kernel/segment.h>
 #include <bsys/util.h>
+#include <btron/memory.h>
 
 #ifdef USE_DEVICE_VIDEOMODE_H
 #define	VIDEOMODE	DM1600x32
+#define	SUPPORT_MODEMAP	(1 << VIDEOMODE)
 #else
 #define	VIDEOMODE	0
+#define	SUPPORT_MODEMAP	ALL_VIDEO_MODE
 #endif
 
-#define	SUPPORT_MODEMAP	(1 << VIDEOMODE)
-
 struct _vmxinf {
-	FastLock	lock;
+	FastLock	lock;		/* FIFO */
+	FastLock	cmaplock;	/* palette */
 	UH		ioaddr;
 	UW		id;
+	UW		cap;
 	void		*fifobase;
 	UW		fifosize;
 	W		fifoentry;
 	_UW		*fifomem;
+
+	/* interrupt / fence driven flow control */
+	BOOL		irq;		/* TRUE: sleep instead of busy-wait */
+	W		irqno;
+	W		lowpct;		/* low-water mark (% of FIFO) */
+	W		lowwater;	/* insert fence below this (byte) */
+	UW		fence;		/* last fence ID */
+	UW		fencewait;	/* fence not passed yet (0: none) */
+	ID		flgid;		/* fence interrupt */
+
+	UW		locker;		/* tasks holding or waiting lock */
 };
 
 LOCAL	struct _vmxinf	VMXinf;
@@ -39,6 +53,8 @@ LOCAL	struct _vmxinf	VMXinf;
 #define	regENABLE	1
 #define	regWIDTH	2
 #define	regHEIGHT	3
+#define	regMAX_WIDTH	4
+#define	regMAX_HEIGHT	5
 #define	regBPP		7
 #define	regPITCH	12
 #define	regVRAMSIZE	15
@@ -48,16 +64,36 @@ LOCAL	struct _vmxinf	VMXinf;
 #define	regCONFIG	20
 #define	regSYNC		21
 #define	regBUSY		22
+#define	regCURSOR_ID	24
+#define	regCURSOR_X	25
+#define	regCURSOR_Y	26
+#define	regCURSOR_ON	27
 #define	regIRQMASK	33
 #define	regPALETTE	1024
 
 #define	regID_MAGIC(x)	(0x90000000 | ((x) & 0xff))
+#define	regCAP_RECT_FILL	(1 << 0)
+#define	regCAP_RECT_COPY	(1 << 1)
+#define	regCAP_RASTER_OP	(1 << 4)
+#define	regCAP_CURSOR_BYPASS_2	(1 << 7)
+#define	regCAP_ALPHA_CURSOR	(1 << 9)
+#define	regCAP_EXTFIFO	(1 << 15)
 #define	regCAP_IRQMASK	(1 << 18)
 
+#define	portIRQSTATUS	8
+#define	irqANY_FENCE	(1 << 0)
+
 #define	fifoMIN		0
 #define	fifoMAX		1
 #define	fifoNEXT	2
 #define	fifoSTOP	3
+#define	fifoCAP		4
+#define	fifoFENCE	6
+#define	fifoBUSY	290
+
+#define	fifoCAP_FENCE	(1 << 0)
+
+#define	pciINTLINE	0x3c
 
 /*
  * VMware SVGA Device Developer Kit sets 0x48c to fifoMIN (SVGA_FIFO_MIN)
@@ -76,28 +112,255 @@ struct _fifocmd {
 } __attribute__((packed));
 
 #define	fifoCMD_UPDATE	1
+#define	fifoCMD_RECT_FILL	2
+#define	fifoCMD_RECT_COPY	3
+#define	fifoCMD_RECT_ROP_COPY	14
+#define	fifoCMD_DEFINE_ALPHA_CURSOR	22
+#define	fifoCMD_FENCE	30
 #define	CMD_ENTRY_MIN	2	/* minimal value */
 
+#define	LOWWATER_DEF	25	/* fence insertion point (% of FIFO) */
+#define	IRQ_TMO		10	/* sleep timeout (msec), in case of lost IRQ */
+#define	FENCE_POLL	1	/* polling interval of client fence (msec) */
+
+#define	FLG_EXINF	((void *)CH4toW('v', 'm', 's', 'i'))
+#define	FLG_FENCE	0x01
+
+/* index / value pair must not be split, FIFO and palette use it */
 Inline	void	WriteSVGA(UW index, UW value)
 {
+	UW	imask;
+
+	DI(imask);
 	out_w(VMXinf.ioaddr + 0, index);
 	out_w(VMXinf.ioaddr + 1, value);
+	EI(imask);
 	return;
 }
 
 Inline	UW	ReadSVGA(UW index)
 {
+	UW	imask, value;
+
+	DI(imask);
 	out_w(VMXinf.ioaddr + 0, index);
-	return in_w(VMXinf.ioaddr + 1);
+	value = in_w(VMXinf.ioaddr + 1);
+	EI(imask);
+	return value;
+}
+
+/* VMXinf.lock, contention is counted */
+Inline	void	VMSVGAlock(void)
+{
+#ifdef SCREEN_STATS
+	if (__sync_fetch_and_add(&VMXinf.locker, 1)) STAT_INC(contend);
+#endif
+	Lock(&VMXinf.lock);
+	return;
+}
+
+Inline	void	VMSVGAunlock(void)
+{
+	Unlock(&VMXinf.lock);
+#ifdef SCREEN_STATS
+	__sync_fetch_and_sub(&VMXinf.locker, 1);
+#endif
+	return;
 }
 
 LOCAL	void	VMSVGAsync(void)
 {
+	STAT_INC(fifosync);
 	WriteSVGA(regSYNC, 1);
-	while (ReadSVGA(regBUSY));
+	while (ReadSVGA(regBUSY)) STAT_INC(spin);
+	return;
+}
+
+/* interrupt handler: acknowledge and wake up the fence waiter */
+LOCAL	void	VMSVGAint(UINT dintno)
+{
+	UW	flags;
+
+	flags = in_w(VMXinf.ioaddr + portIRQSTATUS);
+	out_w(VMXinf.ioaddr + portIRQSTATUS, flags);
+
+	if (flags & irqANY_FENCE) set_flg(VMXinf.flgid, FLG_FENCE);
+	EndOfInt(dintno);
+	return;
+}
+
+/* ask host to process FIFO without waiting for it */
+LOCAL	void	VMSVGAdoorbell(void)
+{
+	if (!VMXinf.fifomem[fifoBUSY]) {
+		VMXinf.fifomem[fifoBUSY] = 1;
+		WriteSVGA(regSYNC, 1);
+	}
+	return;
+}
+
+/* TRUE if host has processed fence */
+Inline	BOOL	VMSVGAfencepassed(UW fence)
+{
+	return (W)(VMXinf.fifomem[fifoFENCE] - fence) >= 0;
+}
+
+/*
+	sleep until host has processed fence
+		* waits on event flag, wakeup request of the caller (damage
+		  task) must not be consumed here
+*/
+LOCAL	void	VMSVGAfencesync(UW fence)
+{
+	UINT	ptn;
+
+	while (!VMSVGAfencepassed(fence)) {
+		clr_flg(VMXinf.flgid, ~FLG_FENCE);
+		if (VMSVGAfencepassed(fence)) break;
+		VMSVGAdoorbell();
+		twai_flg(&ptn, VMXinf.flgid, FLG_FENCE, TWF_ORW, IRQ_TMO);
+	}
+	return;
+}
+
+/* free area of FIFO (byte) */
+LOCAL	W	VMSVGAfifofree(void)
+{
+	W	n;
+
+	n = VMXinf.fifomem[fifoSTOP] - VMXinf.fifomem[fifoNEXT];
+	if (n <= 0) n += VMXinf.fifomem[fifoMAX] - VMXinf.fifomem[fifoMIN];
+
+	/* fifoNEXT must not reach fifoSTOP */
+	return n - sizeof(UW);
+}
+
+/* copy command to FIFO, enough space is required */
+LOCAL	void	VMSVGAfifoput(void *cmd, W len)
+{
+	W	min, max, next;
+	UW	*p = cmd;
+
+	min = VMXinf.fifomem[fifoMIN];
+	max = VMXinf.fifomem[fifoMAX];
+	next = VMXinf.fifomem[fifoNEXT];
+
+	/* command may wrap around */
+	for (; len > 0; len -= sizeof(UW)) {
+		*(_UW *)(((void *)VMXinf.fifomem) + next) = *p++;
+		next += sizeof(UW);
+		if (next >= max) next = min;
+	}
+
+	/* drawing must reach VRAM before host sees the command */
+	flushWC();
+	VMXinf.fifomem[fifoNEXT] = next;
+	STAT_INC(fifocmd);
+
 	return;
 }
 
+/* put fence command, returns fence ID */
+LOCAL	UW	VMSVGAfence(void)
+{
+	UW	cmd[2];
+
+	/* fence ID 0 is reserved for "no fence" */
+	if (!++VMXinf.fence) VMXinf.fence++;
+
+	cmd[0] = fifoCMD_FENCE;
+	cmd[1] = VMXinf.fence;
+	VMSVGAfifoput(cmd, sizeof(cmd));
+
+	return VMXinf.fence;
+}
+
+/* wait until FIFO has enough space */
+LOCAL	void	VMSVGAfiforeserve(W len)
+{
+	/* always leave room for fence command */
+	if (VMXinf.irq) len += sizeof(UW) * 2;
+
+	while (VMSVGAfifofree() < len) {
+		if (!VMXinf.irq) {
+			VMSVGAsync();
+			continue;
+		}
+
+		if (!VMXinf.fencewait) VMXinf.fencewait = VMSVGAfence();
+		VMSVGAfencesync(VMXinf.fencewait);
+		VMXinf.fencewait = 0;
+	}
+
+	return;
+}
+
+/* put command to FIFO, caller must take VMXinf.lock */
+LOCAL	void	VMSVGAfifowrite(void *cmd, W len)
+{
+	VMSVGAfiforeserve(len);
+	VMSVGAfifoput(cmd, len);
+
+	/* running short, let host drain FIFO before it gets full */
+	if (VMXinf.irq && !VMXinf.fencewait &&
+	    VMSVGAfifofree() < VMXinf.lowwater) {
+		VMXinf.fencewait = VMSVGAfence();
+		VMSVGAdoorbell();
+	}
+
+	return;
+}
+
+/* wait until host has processed all commands */
+LOCAL	void	VMSVGAfinish(void)
+{
+	if (VMXinf.irq) {
+		VMSVGAfencesync(VMSVGAfence());
+	} else {
+		VMSVGAsync();
+	}
+	return;
+}
+
+/* register interrupt handler */
+LOCAL	ERR	VMSVGAsetint(void)
+{
+	ERR	err;
+	T_CFLG	cflg = {
+		.exinf = FLG_EXINF,
+		.flgatr = TA_TFIFO | TA_WSGL,
+		.iflgptn = 0,
+	};
+	T_DINT	dint = {
+		.intatr = TA_HLNG,
+		.inthdr = VMSVGAint,
+	};
+
+	VMXinf.irqno = inPciConfB(Vinf.pciaddr, pciINTLINE);
+	if (VMXinf.irqno <= 0 || VMXinf.irqno >= 16) {
+		err = ER_NOSPT;
+		goto fin0;
+	}
+
+	err = vcre_flg(&cflg);
+	if (err < E_OK) goto fin0;
+	VMXinf.flgid = (ID)err;
+
+	err = def_int(IV_IRQ(VMXinf.irqno), &dint);
+	if (err < E_OK) goto fin1;
+
+	SetIntMode(IV_IRQ(VMXinf.irqno), IM_LEVEL);
+	EnableInt(IV_IRQ(VMXinf.irqno));
+
+	err = ER_OK;
+	goto fin0;
+
+fin1:
+	del_flg(VMXinf.flgid);
+fin0:
+	return err;
+}
+
 LOCAL	ERR	VMSVGAinit(void)
 {
 	ERR	err;
@@ -106,6 +369,8 @@ LOCAL	ERR	VMSVGAinit(void)
 	/* create lock */
 	err = CreateLockWN(&VMXinf.lock, "vmsc");
 	if (err < ER_OK) goto fin0;
+	err = CreateLockWN(&VMXinf.cmaplock, "vmsp");
+	if (err < ER_OK) goto fin2;
 
 	/* enable FrameBuffer and I/O register */
 	outPciConfH(Vinf.pciaddr, PCR_COMMAND,
@@ -128,17 +393,16 @@ LOCAL	ERR	VMSVGAinit(void)
 		goto fin1;
 	}
 
-	/* map FrameBuffer */
+	/* FrameBuffer, mapped for the display mode at VMSVGAInit() */
 	Vinf.framebuf_addr =
 		(void *)(inPciConfW(Vinf.pciaddr, PCR_BASEADDR_1) & ~0x0f);
 	Vinf.framebuf_total = ReadSVGA(regVRAMSIZE);
-	err = mapFrameBuf(Vinf.framebuf_addr, Vinf.framebuf_total,
-			 &Vinf.f_addr);
-	if (err < ER_OK) goto fin1;
 
 	/* extended stuff (FIFO, interrupt) */
 	VMXinf.fifosize = 0;
+	VMXinf.cap = 0;
 	if (VMXinf.id != regID_MAGIC(0)) {
+		VMXinf.cap = ReadSVGA(regCAP);
 		/* regFIFOSIZE is untrusted, do sanity check */
 		n = ReadSVGA(regFIFOSIZE);
 		if (n >= regFIFOSIZE_MIN) {
@@ -175,10 +439,23 @@ LOCAL	ERR	VMSVGAinit(void)
 		Vinf.attr &= ~USE_VVRAM;
 	}
 
+	/* VMSVGAIRQ: enable(0/1) low-water(%) */
+	VMXinf.irq = FALSE;
+	VMXinf.lowpct = LOWWATER_DEF;
+	if ((n = GetDevConf("VMSVGAIRQ", v)) > 0 && v[0] > 0 &&
+	    VMXinf.fifosize &&
+	    (VMXinf.cap & (regCAP_IRQMASK | regCAP_EXTFIFO)) ==
+	    (regCAP_IRQMASK | regCAP_EXTFIFO)) {
+		if (n > 1 && v[1] > 0 && v[1] < 100) VMXinf.lowpct = v[1];
+		VMXinf.irq = (VMSVGAsetint() >= ER_OK);
+	}
+
 	err = ER_OK;
 	goto fin0;
 
 fin1:
+	DeleteLock(&VMXinf.cmaplock);
+fin2:
 	DeleteLock(&VMXinf.lock);
 fin0:
 	return err;
@@ -186,37 +463,17 @@ fin0:
 
 LOCAL	void	VMSVGAupdatecmd(W x, W y, W dx, W dy)
 {
-	W	min, max, next, stop, remain;
-	struct _fifocmd	*cmd;
+	struct _fifocmd	cmd;
 
 	/* FIFO disabled */
 	if (!VMXinf.fifosize) goto fin0;
 
-	/* gather current FIFO status */
-	min = VMXinf.fifomem[fifoMIN];
-	max = VMXinf.fifomem[fifoMAX];
-	next = VMXinf.fifomem[fifoNEXT];
-	stop = VMXinf.fifomem[fifoSTOP];
-
-	/* put new command */
-	cmd = ((void *)VMXinf.fifomem) + next;
-	cmd->cmd = fifoCMD_UPDATE;
-	cmd->x = x;
-	cmd->y = y;
-	cmd->width = dx;
-	cmd->height = dy;
-
-	/* calculate FIFO free area */
-	next += sizeof(struct _fifocmd);
-	remain = stop - next;
-	if (remain < 0) remain += max - min;
-
-	/* update next pointer */
-	if (next >= max) next = min;
-	VMXinf.fifomem[fifoNEXT] = next;
-
-	/* no enough space for next time, flush now */
-	if (remain <= sizeof(struct _fifocmd)) VMSVGAsync();
+	cmd.cmd = fifoCMD_UPDATE;
+	cmd.x = x;
+	cmd.y = y;
+	cmd.width = dx;
+	cmd.height = dy;
+	VMSVGAfifowrite(&cmd, sizeof(cmd));
 
 fin0:
 	return;
@@ -225,33 +482,236 @@ fin0:
 /* update region */
 LOCAL	void	VMSVGAupdate(W x, W y, W dx, W dy)
 {
-	Lock(&VMXinf.lock);
+	STAT_INC(updscr);
+	VMSVGAlock();
 	VMSVGAupdatecmd(x, y, dx, dy);
-	Unlock(&VMXinf.lock);
+	VMSVGAunlock();
+	return;
+}
+
+/* update region (coalesced by damage.c) */
+LOCAL	void	VMSVGAflush(RECT *rp, W n)
+{
+	VMSVGAlock();
+	for (; n > 0; n--, rp++) {
+		VMSVGAupdatecmd(rp->c.left, rp->c.top,
+				rp->c.right - rp->c.left,
+				rp->c.bottom - rp->c.top);
+	}
+	VMSVGAunlock();
 	return;
 }
 
-/* set color map */
+/* convert updated rectangles to scanout format, then update them */
+LOCAL	void	VMSVGAflushconv(RECT *rp, W n)
+{
+	convRect(rp, n);
+	VMSVGAflush(rp, n);
+	return;
+}
+
+/* wait until host has shown every update (DN_SCRFLUSH) */
+LOCAL	ERR	VMSVGAwait(void)
+{
+	VMSVGAlock();
+	if (VMXinf.fifosize) VMSVGAfinish();
+	VMSVGAunlock();
+	return ER_OK;
+}
+
+/* present fence for client (DN_SCRFENCE), 0 if FIFO has no fence */
+LOCAL	UW	VMSVGAclientfence(void)
+{
+	UW	fence;
+
+	VMSVGAlock();
+	if (VMXinf.fifosize && (VMXinf.fifomem[fifoCAP] & fifoCAP_FENCE)) {
+		VMSVGAfiforeserve(sizeof(UW) * 2);
+		fence = VMSVGAfence();
+		VMSVGAdoorbell();
+	} else {
+		if (VMXinf.fifosize) VMSVGAsync();
+		fence = 0;
+	}
+	VMSVGAunlock();
+
+	return fence;
+}
+
+/* wait for client fence, others may wait for another one at once */
+LOCAL	ERR	VMSVGAfencewait(UW fence, W tmout)
+{
+	W	t;
+
+	for (t = 0; !VMSVGAfencepassed(fence); t += FENCE_POLL) {
+		if (tmout >= 0 && t >= tmout) return ER_TMOUT;
+		VMSVGAdoorbell();
+		dly_tsk(FENCE_POLL);
+	}
+
+	return ER_OK;
+}
+
+/* mouse cursor, position is just register write */
+LOCAL	ERR	VMSVGAcursor(W kind, void *buf, W size)
+{
+	ERR	err;
+	W	n;
+	ScrCurShape	*shape = buf;
+	ScrCurPos	*pos = buf;
+	LOCAL	UW	cmd[6 + CURSOR_MAX * CURSOR_MAX];
+
+	if (!VMXinf.fifosize ||
+	    (VMXinf.cap & (regCAP_ALPHA_CURSOR | regCAP_CURSOR_BYPASS_2)) !=
+	    (regCAP_ALPHA_CURSOR | regCAP_CURSOR_BYPASS_2)) {
+		err = ER_NOSPT;
+		goto fin0;
+	}
+
+	switch (kind) {
+	case SCRCUR_SHAPE:
+		n = shape->w * shape->h;
+
+		/* small FIFO (VMSVGACMDENTRY) never has room for the image,
+		   one word is kept free and two are for fence */
+		if ((6 + n + 3) * sizeof(UW) >
+		    VMXinf.fifomem[fifoMAX] - VMXinf.fifomem[fifoMIN]) {
+			err = ER_NOSPT;
+			goto fin0;
+		}
+
+		/* cmd[] is shared, VMXinf.lock protects it */
+		VMSVGAlock();
+		cmd[0] = fifoCMD_DEFINE_ALPHA_CURSOR;
+		cmd[1] = 0;		/* cursor ID */
+		cmd[2] = shape->hotx;
+		cmd[3] = shape->hoty;
+		cmd[4] = shape->w;
+		cmd[5] = shape->h;
+		memcpy(&cmd[6], shape + 1, n * sizeof(UW));
+		VMSVGAfifowrite(cmd, (6 + n) * sizeof(UW));
+		VMSVGAunlock();
+		break;
+
+	case SCRCUR_MOVE:
+		WriteSVGA(regCURSOR_ID, 0);
+		WriteSVGA(regCURSOR_X, pos->x);
+		WriteSVGA(regCURSOR_Y, pos->y);
+		WriteSVGA(regCURSOR_ON, pos->visible ? 1 : 0);
+		break;
+
+	default:
+		err = ER_NOSPT;
+		goto fin0;
+	}
+
+	err = ER_OK;
+fin0:
+	return err;
+}
+
+/* screen write (2D acceleration) */
+LOCAL	ERR	VMSVGAwrite(W kind, void *buf, W size)
+{
+	ERR	err;
+	W	n;
+	UW	cmd[8];
+	RECT	r;
+	PNT	sp;
+	ScrWrFill	*fill = buf;
+	ScrWrCopy	*copy = buf;
+
+	/* FIFO disabled, or host can not draw on converted virtual VRAM */
+	if (!VMXinf.fifosize || Vinf.scanbits) {
+		err = ER_NOSPT;
+		goto fin0;
+	}
+
+	switch (kind) {
+	case SCRWR_FILL:
+		if (size < sizeof(ScrWrFill) ||
+		    !(VMXinf.cap & regCAP_RECT_FILL)) {
+			err = ER_NOSPT;
+			goto fin0;
+		}
+		r = fill->r;
+		if (!clipRect(&r, NULL)) goto fin1;
+
+		cmd[0] = fifoCMD_RECT_FILL;
+		cmd[1] = fill->pixel;
+		n = 2;
+		break;
+
+	case SCRWR_COPY:
+	case SCRWR_ROPCOPY:
+		if (size < sizeof(ScrWrCopy)) {
+			err = ER_NOSPT;
+			goto fin0;
+		}
+		if (kind == SCRWR_COPY || copy->rop == SCRROP_COPY) {
+			if (!(VMXinf.cap & regCAP_RECT_COPY)) {
+				err = ER_NOSPT;
+				goto fin0;
+			}
+			cmd[0] = fifoCMD_RECT_COPY;
+		} else {
+			if (!(VMXinf.cap & regCAP_RASTER_OP) ||
+			    (copy->rop & ~0x0f)) {
+				err = ER_NOSPT;
+				goto fin0;
+			}
+			cmd[0] = fifoCMD_RECT_ROP_COPY;
+		}
+		r = copy->r;
+		sp = copy->sp;
+		if (!clipRect(&r, &sp)) goto fin1;
+
+		cmd[1] = sp.x;
+		cmd[2] = sp.y;
+		n = 3;
+		break;
+
+	default:
+		err = ER_NOSPT;
+		goto fin0;
+	}
+
+	cmd[n++] = r.c.left;
+	cmd[n++] = r.c.top;
+	cmd[n++] = r.c.right - r.c.left;
+	cmd[n++] = r.c.bottom - r.c.top;
+	if (cmd[0] == fifoCMD_RECT_ROP_COPY) cmd[n++] = copy->rop;
+
+	/* host writes VRAM, wait for completion before client touches it */
+	VMSVGAlock();
+	VMSVGAfifowrite(cmd, sizeof(UW) * n);
+	VMSVGAfinish();
+	VMSVGAunlock();
+
+fin1:
+	err = ER_OK;
+fin0:
+	return err;
+}
+
+/* set color map, called only when color map is used */
 LOCAL	void	VMSVGAsetcmap(COLOR *cmap, W index, W entries)
 {
-#if defined(COLOR_CMAP256)
 	W	i, reg;
 
 	reg = (VMXinf.id == regID_MAGIC(0)) ? regPALETTE0 : regPALETTE;
-
-	Lock(&VMXinf.lock);
-	for (i = index; i < index + entries; i++) {
-		WriteSVGA(reg + i * 3 + 0, (*cmap >> (16)) & 0xff);
-		WriteSVGA(reg + i * 3 + 1, (*cmap >> (8)) & 0xff);
-		WriteSVGA(reg + i * 3 + 2, (*cmap >> (0)) & 0xff);
+	reg += index * 3;
+	STAT_ADD(palette, entries);
+
+	/* palette registers do not touch FIFO, updates are not stalled */
+	Lock(&VMXinf.cmaplock);
+	for (i = 0; i < entries; i++) {
+		WriteSVGA(reg++, (*cmap >> (16)) & 0xff);
+		WriteSVGA(reg++, (*cmap >> (8)) & 0xff);
+		WriteSVGA(reg++, (*cmap >> (0)) & 0xff);
 		cmap++;
 	}
-	Unlock(&VMXinf.lock);
-
-#else
-	/* no support, do nothing */
-
-#endif
+	Unlock(&VMXinf.cmaplock);
 	return;
 }
 
@@ -263,22 +723,31 @@ LOCAL	void	VMSVGAsetmode(W flg)
 	/* exit VMware SVGA II mode, required for warm reboot */
 	// XXX the last contents of VGA mode is redisplayed when exiting.
 	if (flg < 0) {
-		Lock(&VMXinf.lock);
+		flushDamage();
+		VMSVGAlock();
 		if (VMXinf.fifosize) {
 			VMSVGAsync();
 			WriteSVGA(regCONFIG, 0);
 		}
+		if (VMXinf.irq) {
+			WriteSVGA(regIRQMASK, 0);
+			DisableInt(IV_IRQ(VMXinf.irqno));
+			VMXinf.irq = FALSE;
+		}
 		WriteSVGA(regENABLE, 0);
 		VMXinf.fifosize = 0;
 		Vinf.attr &= ~USE_VVRAM;
-		Unlock(&VMXinf.lock);
+		VMSVGAunlock();
 		return;
 	}
 
-	/* initialize */
+	/* initialize, FIFO may be running when mode is changed */
+	VMSVGAlock();
+	if (VMXinf.fifosize && ReadSVGA(regCONFIG)) VMSVGAsync();
+
 	WriteSVGA(regWIDTH, Vinf.act_width);
 	WriteSVGA(regHEIGHT, Vinf.act_height);
-	WriteSVGA(regBPP, Vinf.pixbits >> 8);
+	WriteSVGA(regBPP, ScanBits >> 8);
 
 	if (VMXinf.fifosize) {
 		max = (VMXinf.fifosize - fifoMIN_MIN) / sizeof(struct _fifocmd);
@@ -293,6 +762,20 @@ LOCAL	void	VMSVGAsetmode(W flg)
 			VMXinf.fifoentry;
 		VMXinf.fifomem[fifoMAX] = VMXinf.fifosize;
 		WriteSVGA(regCONFIG, 1);
+
+		/* fence is required for interrupt driven flow control */
+		if (VMXinf.irq && !(VMXinf.fifomem[fifoCAP] & fifoCAP_FENCE)) {
+			DisableInt(IV_IRQ(VMXinf.irqno));
+			VMXinf.irq = FALSE;
+		}
+		if (VMXinf.irq) {
+			VMXinf.lowwater = (VMXinf.fifosize -
+					   VMXinf.fifomem[fifoMIN]) *
+				VMXinf.lowpct / 100;
+			VMXinf.fence = VMXinf.fifomem[fifoFENCE];
+			VMXinf.fencewait = 0;
+			WriteSVGA(regIRQMASK, irqANY_FENCE);
+		}
 	} else {
 		WriteSVGA(regCONFIG, 0);
 	}
@@ -304,8 +787,11 @@ LOCAL	void	VMSVGAsetmode(W flg)
 	/* fix display mode information */
 	Vinf.width = Vinf.fb_width = Vinf.act_width;
 	Vinf.height = Vinf.fb_height = Vinf.act_height;
-	Vinf.rowbytes = Vinf.framebuf_rowb = ReadSVGA(regPITCH);
-	Vinf.vramsz = Vinf.framebuf_rowb * Vinf.fb_height;
+	Vinf.framebuf_rowb = ReadSVGA(regPITCH);
+	Vinf.rowbytes = Vinf.scanbits ?
+		Vinf.act_width * Vinf.pixbyte : Vinf.framebuf_rowb;
+	Vinf.vramsz = Vinf.rowbytes * Vinf.fb_height;
+	VMSVGAunlock();
 
 	return;
 }
@@ -315,12 +801,13 @@ LOCAL	void	VMSVGAsuspend(BOOL suspend)
 {
         /* in the case of suspend, clear Video-RAM content */
 	if (suspend) {
-		Lock(&VMXinf.lock);
+		flushDamage();
+		VMSVGAlock();
 //		memset(Vinf.f_addr, 0, Vinf.framebuf_total);
 //		VMSVGAupdatecmd(0, 0, Vinf.width, Vinf.height);
 		if (VMXinf.fifosize) VMSVGAsync();
 	} else {
-		Unlock(&VMXinf.lock);
+		VMSVGAunlock();
 	}
 
 	return;
@@ -343,9 +830,10 @@ EXPORT	W	VMSVGAInit(void)
 	if (err < ER_OK) goto fin0;
 
 	/* set Vinf */
-	Vinf.reqmode = Vinf.curmode = VIDEOMODE;
+	setModeMap(SUPPORT_MODEMAP, VIDEOMODE,
+		   ReadSVGA(regMAX_WIDTH), ReadSVGA(regMAX_HEIGHT));
 	// Vinf.framebuf_addr is already set
-	// Vinf.f_addr is already set
+	// Vinf.f_addr is set below
 	strncpy(Vinf.chipinf, "VMware SVGA II", L_CHIPINF);
 	// Vinf.framebuf_total is already set
 	Vinf.attr |= (LINEAR_FRAMEBUF | NEED_FINPROC | NEED_SUSRESPROC);
@@ -353,18 +841,40 @@ EXPORT	W	VMSVGAInit(void)
 	Vinf.fn_setcmap = VMSVGAsetcmap;
 	Vinf.fn_setmode = VMSVGAsetmode;
 	Vinf.fn_susres = VMSVGAsuspend;
-	Vinf.modemap = SUPPORT_MODEMAP;
-
-	if (Vinf.attr & USE_VVRAM) {
-		Vinf.fn_updscr = VMSVGAupdate;
-		Vinf.v_addr = Vinf.f_addr;
-	}
+	Vinf.fn_write = VMSVGAwrite;
+	Vinf.fn_sync = VMSVGAwait;
+	Vinf.fn_cursor = VMSVGAcursor;
+	Vinf.fn_fence = VMSVGAclientfence;
+	Vinf.fn_fencewait = VMSVGAfencewait;
 
 	/* these values are temporally, fix them at VMSVGAsetmode() */
 	Vinf.fb_width = Vinf.framebuf_rowb = VideoHsize(Vinf.reqmode);
 	Vinf.fb_height = VideoVsize(Vinf.reqmode);
 	Vinf.framebuf_rowb *= (VideoPixBits(Vinf.reqmode) >> 11) & 0x1f;
 
+	/* map whole FrameBuffer, it is not remapped at mode change */
+	err = allocFrameBuf();
+	if (err < ER_OK) goto fin0;
+
+	/* scanout format conversion needs separate virtual VRAM */
+	if (Vinf.scanbits &&
+	    (!(Vinf.attr & USE_VVRAM) ||
+	     allocVVRAM() < ER_OK ||
+	     initDamage(DMG_RECT, VMSVGAflushconv) < ER_OK)) {
+		if (Vinf.v_addr != NULL) b_rel_mbk(Vinf.v_addr);
+		Vinf.v_addr = NULL;
+		Vinf.scanbits = 0;
+	}
+
+	if (Vinf.scanbits) {
+		Vinf.fn_updscr = addDamage;
+	} else if (Vinf.attr & USE_VVRAM) {
+		/* merge small updates, or update immediately if unavailable */
+		Vinf.fn_updscr = (initDamage(DMG_RECT, VMSVGAflush) < ER_OK) ?
+			VMSVGAupdate : addDamage;
+		Vinf.v_addr = Vinf.f_addr;
+	}
+
 	err = 1;
 	goto fin0;
 